@@ -15,6 +15,14 @@ extern "C" {
 JNIEXPORT jint JNICALL Java_com_mogujie_algo_openvino_jni_MoguOpenvino_create
   (JNIEnv *, jclass, jstring, jstring);
 
+/*
+ * Class:     com_mogujie_algo_openvino_jni_MoguOpenvino
+ * Method:    createEx
+ * Signature: (Ljava/lang/String;Ljava/lang/String;Ljava/lang/String;)I
+ */
+JNIEXPORT jint JNICALL Java_com_mogujie_algo_openvino_jni_MoguOpenvino_createEx
+  (JNIEnv *, jclass, jstring, jstring, jstring);
+
 /*
  * Class:     com_mogujie_algo_openvino_jni_MoguOpenvino
  * Method:    inference
@@ -23,6 +31,38 @@ JNIEXPORT jint JNICALL Java_com_mogujie_algo_openvino_jni_MoguOpenvino_create
 JNIEXPORT jfloatArray JNICALL Java_com_mogujie_algo_openvino_jni_MoguOpenvino_inference
   (JNIEnv *, jclass, jstring, jcharArray, jint, jint, jint);
 
+/*
+ * Class:     com_mogujie_algo_openvino_jni_MoguOpenvino
+ * Method:    inferenceFP16
+ * Signature: (Ljava/lang/String;[CIII)[S
+ */
+JNIEXPORT jshortArray JNICALL Java_com_mogujie_algo_openvino_jni_MoguOpenvino_inferenceFP16
+  (JNIEnv *, jclass, jstring, jcharArray, jint, jint, jint);
+
+/*
+ * Class:     com_mogujie_algo_openvino_jni_MoguOpenvino
+ * Method:    inferenceInt8
+ * Signature: (Ljava/lang/String;[CIII)[B
+ */
+JNIEXPORT jbyteArray JNICALL Java_com_mogujie_algo_openvino_jni_MoguOpenvino_inferenceInt8
+  (JNIEnv *, jclass, jstring, jcharArray, jint, jint, jint);
+
+/*
+ * Class:     com_mogujie_algo_openvino_jni_MoguOpenvino
+ * Method:    inferenceMulti
+ * Signature: ([Ljava/lang/String;[CIII)[[F
+ */
+JNIEXPORT jobjectArray JNICALL Java_com_mogujie_algo_openvino_jni_MoguOpenvino_inferenceMulti
+  (JNIEnv *, jclass, jobjectArray, jcharArray, jint, jint, jint);
+
+/*
+ * Class:     com_mogujie_algo_openvino_jni_MoguOpenvino
+ * Method:    isReady
+ * Signature: (Ljava/lang/String;)Z
+ */
+JNIEXPORT jboolean JNICALL Java_com_mogujie_algo_openvino_jni_MoguOpenvino_isReady
+  (JNIEnv *, jclass, jstring);
+
 /*
  * Class:     com_mogujie_algo_openvino_jni_MoguOpenvino
  * Method:    release
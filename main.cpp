@@ -31,6 +31,7 @@
 #include <pthread.h>
 
 #include "classification_sample.h"
+#include "mogu_weights_cache.h"
 
 using namespace InferenceEngine;
 
@@ -404,8 +405,13 @@ int main(int argc, char *argv[]) {
     /** 读取模型描述文件 **/
     networkReader.ReadNetwork(FLAGS_m);
 
-    /** 读取模型权重文件 **/
-    networkReader.ReadWeights(binFileName);
+    /** 读取模型权重文件,两个网络共享同一份内存映射,映射失败时退回整体读取 **/
+    std::shared_ptr<const MappedWeights> weights = WeightsCache::instance().get(binFileName);
+    if (weights) {
+        networkReader.SetWeights(weights->blob());
+    } else {
+        networkReader.ReadWeights(binFileName);
+    }
     CNNNetwork network = networkReader.getNetwork();
 
     slog::info << "Preparing input blobs" << slog::endl;
@@ -491,7 +497,11 @@ int main(int argc, char *argv[]) {
     networkReader2.ReadNetwork(FLAGS_m);
 
     /** 读取模型权重文件 **/
-    networkReader2.ReadWeights(binFileName);
+    if (weights) {
+        networkReader2.SetWeights(weights->blob());
+    } else {
+        networkReader2.ReadWeights(binFileName);
+    }
     CNNNetwork network2 = networkReader2.getNetwork();
 
     slog::info << "Preparing input blobs" << slog::endl;
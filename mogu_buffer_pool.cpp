@@ -0,0 +1,64 @@
+//
+// Created by adai on 2019/01/15.
+//
+
+#include "mogu_buffer_pool.h"
+
+#include <cstdlib>
+#include <new>
+
+/**
+ * 池本身不析构,避免进程退出时仍有输出在归还缓冲区
+ */
+BufferPool &BufferPool::instance() {
+    static BufferPool *pool = new BufferPool();
+    return *pool;
+}
+
+/**
+ * 借出缓冲区
+ */
+float *BufferPool::acquire(size_t size, size_t &capacity) {
+    int sizeClass = minClass;
+    while (sizeClass <= maxClass && (static_cast<size_t>(1) << sizeClass) < size) {
+        ++sizeClass;
+    }
+    /** 超出最大分级时按实际大小申请 **/
+    if (sizeClass > maxClass) {
+        capacity = size;
+    } else {
+        capacity = static_cast<size_t>(1) << sizeClass;
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!freeLists[sizeClass].empty()) {
+            float *pBuffer = freeLists[sizeClass].back();
+            freeLists[sizeClass].pop_back();
+            return pBuffer;
+        }
+    }
+    void *pBuffer = nullptr;
+    if (posix_memalign(&pBuffer, 64, capacity * sizeof(float)) != 0) {
+        throw std::bad_alloc();
+    }
+    return static_cast<float *>(pBuffer);
+}
+
+/**
+ * 归还缓冲区
+ */
+void BufferPool::release(float *pBuffer, size_t capacity) {
+    if (!pBuffer) {
+        return;
+    }
+    int sizeClass = minClass;
+    while (sizeClass <= maxClass && (static_cast<size_t>(1) << sizeClass) < capacity) {
+        ++sizeClass;
+    }
+    if (sizeClass <= maxClass && (static_cast<size_t>(1) << sizeClass) == capacity) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (freeLists[sizeClass].size() < maxCached) {
+            freeLists[sizeClass].push_back(pBuffer);
+            return;
+        }
+    }
+    free(pBuffer);
+}
@@ -0,0 +1,47 @@
+//
+// Created by adai on 2019/01/15.
+//
+
+#ifndef DDUP_MOGU_BUFFER_POOL_H
+#define DDUP_MOGU_BUFFER_POOL_H
+
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+/**
+ * 进程级float缓冲区池
+ * 按2的幂分级缓存释放的缓冲区,稳定运行时输出结果不再向堆申请内存
+ */
+class BufferPool {
+public:
+    static BufferPool &instance();
+
+    /**
+     * 借出至少size个float的缓冲区(64字节对齐)
+     * @param capacity 实际容量,归还时原样传回
+     */
+    float *acquire(size_t size, size_t &capacity);
+
+    /**
+     * 归还缓冲区,超出缓存上限时直接释放
+     */
+    void release(float *pBuffer, size_t capacity);
+
+private:
+    BufferPool() = default;
+
+    /**
+     * 最小/最大分级(2的幂,单位为float个数),超出最大分级的缓冲区不缓存
+     */
+    static const int minClass = 6, maxClass = 26;
+    /**
+     * 每一级最多缓存的缓冲区个数
+     */
+    static const size_t maxCached = 64;
+
+    std::mutex mutex;
+    std::vector<float *> freeLists[maxClass + 1];
+};
+
+#endif //DDUP_MOGU_BUFFER_POOL_H
@@ -0,0 +1,195 @@
+//
+// Created by adai on 2019/01/23.
+//
+
+/**
+ * INT8校准工具
+ * 用法: ddup_calibrate <modelDir> <modelName> <imageDir> [maxImages]
+ * 1. 以校准模式加载FP32网络,样本图片经ex_pic生成全部视图后推断,收集各层各通道的最小/最大值,
+ *    写出<modelDir>/<modelName>.stats
+ * 2. 分别加载FP32网络和加载统计量的INT8网络,逐视图比较第一个输出层,报告余弦漂移;
+ *    漂移可接受时在.config中加入int8Stats=<modelName>.stats开启INT8
+ */
+
+#include "mogu_openvino.h"
+#include "mogu_network_stats.h"
+#include "mogu_reduce.h"
+
+#include <dirent.h>
+#include <algorithm>
+#include <limits>
+
+/**
+ * 校准和比较时统一的推断方式:逐张推断,返回每个视图的FP32结果,不预热
+ */
+static const char *kCommonOptions = "reduction=none;earlyExitCosine=0;replicas=1;batchImages=1;pluginPreprocess=0;"
+                                    "latencyParts=0;inferenceMode=throughput;outputEncoding=fp32;warmUpRounds=0";
+
+/**
+ * 列出目录中的图片,按文件名排序,最多maxImages张
+ */
+static std::vector<std::string> list_images(const std::string &imageDir, size_t maxImages) {
+    std::vector<std::string> images;
+    DIR *pDir = opendir(imageDir.c_str());
+    if (!pDir) {
+        slog::err << "can not open image dir: " << imageDir << slog::endl;
+        return images;
+    }
+    while (struct dirent *pEntry = readdir(pDir)) {
+        std::string name(pEntry->d_name);
+        size_t dot = name.rfind('.');
+        if (dot == std::string::npos) {
+            continue;
+        }
+        std::string ext = name.substr(dot + 1);
+        std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+        if (ext == "jpg" || ext == "jpeg" || ext == "png" || ext == "bmp") {
+            images.push_back(imageDir + "/" + name);
+        }
+    }
+    closedir(pDir);
+    std::sort(images.begin(), images.end());
+    if (images.size() > maxImages) {
+        images.resize(maxImages);
+    }
+    return images;
+}
+
+/**
+ * 创建网络,options优先于.config
+ */
+static std::shared_ptr<Openvino_Net> create_net(const std::string &modelDir, const std::string &modelName,
+                                                const std::string &options) {
+    Config config;
+    config.modelDir = modelDir;
+    config.modelName = modelName;
+    config.addOverrides(options);
+    std::shared_ptr<Openvino_Net> net = std::make_shared<Openvino_Net>(config);
+    if (!net->create_inf_engine()) {
+        return nullptr;
+    }
+    return net;
+}
+
+/**
+ * 读取图片并推断
+ */
+static int infer_image(Openvino_Net &net, const std::string &imagePath, Output &output) {
+    cv::Mat image = cv::imread(imagePath, cv::IMREAD_COLOR);
+    if (image.empty()) {
+        slog::warn << "skip unreadable image: " << imagePath << slog::endl;
+        return 0;
+    }
+    if (!image.isContinuous()) {
+        image = image.clone();
+    }
+    net.inference(output, image.data, image.cols, image.rows);
+    return 1;
+}
+
+/**
+ * 按通道(第二维)累计各层输出的最小/最大值
+ */
+static void collect_stats(Output &output, NetworkStatsMap &stats) {
+    for (auto &item : output.tensors) {
+        OutputTensor &tensor = item.second;
+        const std::vector<size_t> &shape = tensor.shape;
+        size_t batch = shape.empty() ? 1 : shape[0];
+        size_t channels = shape.size() > 1 ? shape[1] : 1;
+        size_t inner = 1;
+        for (size_t i = 2; i < shape.size(); ++i) {
+            inner *= shape[i];
+        }
+        NetworkNodeStatsPtr &nodeStats = stats[item.first];
+        if (!nodeStats) {
+            nodeStats = std::make_shared<NetworkNodeStats>();
+            nodeStats->_minOutputs.assign(channels, std::numeric_limits<float>::max());
+            nodeStats->_maxOutputs.assign(channels, std::numeric_limits<float>::lowest());
+        }
+        for (size_t n = 0; n < batch; ++n) {
+            for (size_t c = 0; c < channels; ++c) {
+                const float *pData = tensor.data + (n * channels + c) * inner;
+                const auto range = std::minmax_element(pData, pData + inner);
+                nodeStats->_minOutputs[c] = std::min(nodeStats->_minOutputs[c], *range.first);
+                nodeStats->_maxOutputs[c] = std::max(nodeStats->_maxOutputs[c], *range.second);
+            }
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 4) {
+        printf("usage: %s <modelDir> <modelName> <imageDir> [maxImages]\n", argv[0]);
+        return 1;
+    }
+    std::string modelDir(argv[1]);
+    std::string modelName(argv[2]);
+    size_t maxImages = argc > 4 ? static_cast<size_t>(atoi(argv[4])) : 200;
+    std::vector<std::string> images = list_images(argv[3], maxImages);
+    if (images.empty()) {
+        slog::err << "no calibration images" << slog::endl;
+        return 1;
+    }
+    std::string statsName = modelName + ".stats";
+    std::string statsFile = modelDir + "/" + statsName;
+
+    /** 校准:收集各层统计量 **/
+    {
+        std::shared_ptr<Openvino_Net> net = create_net(modelDir, modelName,
+                                                       std::string(kCommonOptions) + ";calibrate=1;outputs=;int8Stats=");
+        if (!net) {
+            slog::err << "can not create calibration network" << slog::endl;
+            return 1;
+        }
+        NetworkStatsMap stats;
+        Output output;
+        size_t used = 0;
+        for (const auto &imagePath : images) {
+            if (infer_image(*net, imagePath, output)) {
+                collect_stats(output, stats);
+                ++used;
+            }
+        }
+        if (!used || !write_network_stats(statsFile, stats)) {
+            return 1;
+        }
+        slog::info << "wrote stats of " << stats.size() << " layers from " << used << " images to " << statsFile
+                   << slog::endl;
+    }
+
+    /** 比较FP32与INT8的输出漂移 **/
+    std::shared_ptr<Openvino_Net> fp32Net = create_net(modelDir, modelName, std::string(kCommonOptions) + ";int8Stats=");
+    std::shared_ptr<Openvino_Net> int8Net = create_net(modelDir, modelName,
+                                                       std::string(kCommonOptions) + ";int8Stats=" + statsName);
+    if (!fp32Net || !int8Net) {
+        slog::err << "can not create fp32/int8 network" << slog::endl;
+        return 1;
+    }
+    Output fp32Output, int8Output;
+    double sum = 0;
+    float minCosine = 1.0f;
+    size_t rows = 0;
+    for (const auto &imagePath : images) {
+        if (!infer_image(*fp32Net, imagePath, fp32Output) || !infer_image(*int8Net, imagePath, int8Output)) {
+            continue;
+        }
+        OutputTensor &fp32Tensor = fp32Output.first();
+        OutputTensor &int8Tensor = int8Output.first();
+        size_t views = fp32Tensor.shape[0];
+        size_t rowDim = static_cast<size_t>(fp32Tensor.getTotalDim()) / views;
+        for (size_t v = 0; v < views; ++v) {
+            float cosine = cosine_similarity(fp32Tensor.data + v * rowDim, int8Tensor.data + v * rowDim, rowDim);
+            sum += cosine;
+            minCosine = std::min(minCosine, cosine);
+            ++rows;
+        }
+    }
+    if (!rows) {
+        return 1;
+    }
+    printf("%s int8 cosine drift over %zu views: mean %.6f, min %.6f\n", modelName.c_str(), rows, sum / rows,
+           minCosine);
+    printf("add \"int8Stats=%s\" to %s/%s.config to enable int8\n", statsName.c_str(), modelDir.c_str(),
+           modelName.c_str());
+    return 0;
+}
@@ -0,0 +1,122 @@
+//
+// Created by adai on 2019/01/26.
+//
+
+#include "mogu_cascade.h"
+
+#include <algorithm>
+#include <limits>
+
+/**
+ * 追加阶段
+ */
+void Openvino_Cascade::addStage(std::shared_ptr<Openvino_Net> net, CascadeAccept accept) {
+    std::unique_ptr<Stage> stage(new Stage());
+    stage->net = std::move(net);
+    stage->accept = std::move(accept);
+    stages.push_back(std::move(stage));
+}
+
+/**
+ * 级联推断
+ */
+int Openvino_Cascade::inference(Output &output, unsigned char *pImageHead, int imageW, int imageH) {
+    for (size_t i = 0; i < stages.size(); ++i) {
+        Stage &stage = *stages[i];
+        /** 各阶段的输出层不同,取各自的默认输出层 **/
+        output.names.clear();
+        stage.net->inference(output, pImageHead, imageW, imageH);
+        ++stage.runs;
+        if (i + 1 == stages.size() || !stage.accept || stage.accept(output)) {
+            ++stage.accepts;
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+/**
+ * 各阶段的计数
+ */
+std::vector<Openvino_Cascade::StageStats> Openvino_Cascade::stats() const {
+    std::vector<StageStats> result;
+    for (const auto &stage : stages) {
+        result.push_back({stage->runs.load(), stage->accepts.load()});
+    }
+    return result;
+}
+
+/**
+ * 清零计数
+ */
+void Openvino_Cascade::resetStats() {
+    for (auto &stage : stages) {
+        stage->runs = 0;
+        stage->accepts = 0;
+    }
+}
+
+/**
+ * 第一个输出层首行,结果已编码(非FP32)时返回nullptr
+ */
+static const float *first_row(Output &output, size_t &rowDim) {
+    OutputTensor &tensor = output.first();
+    if (!tensor.data || tensor.shape.empty() || tensor.shape[0] == 0) {
+        return nullptr;
+    }
+    rowDim = static_cast<size_t>(tensor.getTotalDim()) / tensor.shape[0];
+    return tensor.data;
+}
+
+/**
+ * 最大值测试
+ */
+CascadeAccept Openvino_Cascade::max_score(float threshold) {
+    return [threshold](Output &output) {
+        size_t rowDim = 0;
+        const float *pRow = first_row(output, rowDim);
+        return pRow && rowDim && *std::max_element(pRow, pRow + rowDim) >= threshold;
+    };
+}
+
+/**
+ * 最大值与次大值之差测试
+ */
+CascadeAccept Openvino_Cascade::margin(float threshold) {
+    return [threshold](Output &output) {
+        size_t rowDim = 0;
+        const float *pRow = first_row(output, rowDim);
+        if (!pRow || rowDim < 2) {
+            return false;
+        }
+        float top1 = std::numeric_limits<float>::lowest(), top2 = top1;
+        for (size_t i = 0; i < rowDim; ++i) {
+            if (pRow[i] > top1) {
+                top2 = top1;
+                top1 = pRow[i];
+            } else if (pRow[i] > top2) {
+                top2 = pRow[i];
+            }
+        }
+        return top1 - top2 >= threshold;
+    };
+}
+
+/**
+ * 解析测试
+ */
+CascadeAccept Openvino_Cascade::parse_accept(const std::string &spec) {
+    size_t pos = spec.find(':');
+    if (pos == std::string::npos) {
+        return nullptr;
+    }
+    std::string type = spec.substr(0, pos);
+    float threshold = static_cast<float>(atof(spec.c_str() + pos + 1));
+    if (type == "max") {
+        return max_score(threshold);
+    }
+    if (type == "margin") {
+        return margin(threshold);
+    }
+    return nullptr;
+}
@@ -0,0 +1,78 @@
+//
+// Created by adai on 2019/01/26.
+//
+
+#ifndef DDUP_MOGU_CASCADE_H
+#define DDUP_MOGU_CASCADE_H
+
+#include "mogu_openvino.h"
+
+#include <atomic>
+
+/**
+ * 判断某一阶段的结果是否可以直接采用
+ */
+typedef std::function<bool(Output &output)> CascadeAccept;
+
+/**
+ * 级联推断:先用廉价模型推断,结果未通过该阶段的置信度测试时再用下一个(更贵的)模型推断
+ * 各阶段的网络独立创建(可来自模型注册表),各阶段取各自的默认输出层
+ */
+class Openvino_Cascade {
+public:
+    /**
+     * 某一阶段的计数
+     */
+    struct StageStats {
+        /**
+         * 推断次数,结果被采用的次数
+         */
+        uint64_t runs, accepts;
+    };
+
+    /**
+     * 追加一个阶段;accept为空时该阶段的结果总被采用,最后一个阶段的accept被忽略
+     */
+    void addStage(std::shared_ptr<Openvino_Net> net, CascadeAccept accept = nullptr);
+
+    /**
+     * 推断,output为最终采用阶段的结果
+     * @return 采用结果的阶段序号,没有阶段时返回-1
+     */
+    int inference(Output &output, unsigned char *pImageHead, int imageW, int imageH);
+
+    /**
+     * 各阶段的计数
+     */
+    std::vector<StageStats> stats() const;
+
+    /**
+     * 清零计数
+     */
+    void resetStats();
+
+    /**
+     * 第一个输出层首行的最大值不低于threshold(如分类概率)
+     */
+    static CascadeAccept max_score(float threshold);
+
+    /**
+     * 第一个输出层首行的最大值与次大值之差不低于threshold
+     */
+    static CascadeAccept margin(float threshold);
+
+    /**
+     * 解析"max:0.9"或"margin:0.2"形式的测试,无法解析时返回空
+     */
+    static CascadeAccept parse_accept(const std::string &spec);
+
+private:
+    struct Stage {
+        std::shared_ptr<Openvino_Net> net;
+        CascadeAccept accept;
+        std::atomic<uint64_t> runs{0}, accepts{0};
+    };
+    std::vector<std::unique_ptr<Stage>> stages;
+};
+
+#endif //DDUP_MOGU_CASCADE_H
@@ -0,0 +1,122 @@
+//
+// Created by adai on 2019/01/18.
+//
+
+#include "mogu_cpu_topology.h"
+
+#include <cstdio>
+#include <map>
+#include <utility>
+
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+
+/**
+ * 读取sysfs中的一个整数,失败时返回defaultValue
+ */
+static int read_sysfs_int(const char *path, int defaultValue) {
+    FILE *pFile = fopen(path, "r");
+    if (!pFile) {
+        return defaultValue;
+    }
+    int value;
+    if (fscanf(pFile, "%d", &value) != 1) {
+        value = defaultValue;
+    }
+    fclose(pFile);
+    return value;
+}
+
+/**
+ * 逻辑CPU所在的NUMA节点,没有NUMA信息时为0
+ */
+static int cpu_node(int cpu) {
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+    DIR *pDir = opendir(path);
+    if (!pDir) {
+        return 0;
+    }
+    int node = 0;
+    while (struct dirent *pEntry = readdir(pDir)) {
+        if (sscanf(pEntry->d_name, "node%d", &node) == 1) {
+            break;
+        }
+    }
+    closedir(pDir);
+    return node;
+}
+
+/**
+ * 读取物理核
+ */
+std::vector<PhysicalCore> physical_cores() {
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        return std::vector<PhysicalCore>();
+    }
+
+    /** 按(插槽,核编号)归并超线程 **/
+    std::map<std::pair<int, int>, PhysicalCore> coreMap;
+    char path[96];
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (!CPU_ISSET(cpu, &allowed)) {
+            continue;
+        }
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", cpu);
+        int package = read_sysfs_int(path, 0);
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/core_id", cpu);
+        /** 读取失败时以逻辑CPU编号作为核编号 **/
+        int coreId = read_sysfs_int(path, cpu);
+
+        PhysicalCore &core = coreMap[std::make_pair(package, coreId)];
+        if (core.cpus.empty()) {
+            core.package = package;
+            core.coreId = coreId;
+            core.node = cpu_node(cpu);
+        }
+        core.cpus.push_back(cpu);
+    }
+
+    std::vector<PhysicalCore> cores;
+    for (auto &item : coreMap) {
+        cores.push_back(item.second);
+    }
+    return cores;
+}
+
+/**
+ * 按NUMA节点交替排列物理核
+ */
+std::vector<PhysicalCore> interleave_nodes(const std::vector<PhysicalCore> &cores) {
+    std::map<int, std::vector<const PhysicalCore *>> nodeCores;
+    for (const auto &core : cores) {
+        nodeCores[core.node].push_back(&core);
+    }
+    std::vector<PhysicalCore> interleaved;
+    for (size_t i = 0; interleaved.size() < cores.size(); ++i) {
+        for (auto &item : nodeCores) {
+            if (i < item.second.size()) {
+                interleaved.push_back(*item.second[i]);
+            }
+        }
+    }
+    return interleaved;
+}
+
+/**
+ * 绑定当前线程
+ */
+int pin_current_thread(const std::vector<int> &cpus) {
+    if (cpus.empty()) {
+        return 0;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) {
+        CPU_SET(cpu, &set);
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
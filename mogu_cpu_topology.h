@@ -0,0 +1,41 @@
+//
+// Created by adai on 2019/01/18.
+//
+
+#ifndef DDUP_MOGU_CPU_TOPOLOGY_H
+#define DDUP_MOGU_CPU_TOPOLOGY_H
+
+#include <vector>
+
+/**
+ * 一个物理核
+ */
+struct PhysicalCore {
+    /**
+     * 所在CPU插槽,核编号,NUMA节点
+     */
+    int package = 0, coreId = 0, node = 0;
+    /**
+     * 该物理核上的逻辑CPU(超线程)
+     */
+    std::vector<int> cpus;
+};
+
+/**
+ * 读取当前进程可用的物理核(按插槽,核编号排序)
+ * 拓扑读取失败时每个可用逻辑CPU视为一个物理核
+ */
+std::vector<PhysicalCore> physical_cores();
+
+/**
+ * 按NUMA节点交替排列物理核,使前N个核均匀分布在各节点上
+ */
+std::vector<PhysicalCore> interleave_nodes(const std::vector<PhysicalCore> &cores);
+
+/**
+ * 把当前线程绑定到给定的逻辑CPU
+ * @return 是否绑定成功
+ */
+int pin_current_thread(const std::vector<int> &cpus);
+
+#endif //DDUP_MOGU_CPU_TOPOLOGY_H
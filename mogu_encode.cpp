@@ -0,0 +1,156 @@
+//
+// Created by adai on 2019/01/16.
+//
+
+#include "mogu_encode.h"
+
+#include <cmath>
+#include <algorithm>
+#include <cstring>
+#include <immintrin.h>
+
+/**
+ * 单个float转半精度,就近舍入到偶数,处理次正规数,无穷和NaN
+ */
+static inline uint16_t float_to_half(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000u;
+    uint32_t abs = bits & 0x7fffffffu;
+
+    /** NaN保持为quiet NaN,无穷保持为无穷 **/
+    if (abs >= 0x7f800000u) {
+        return static_cast<uint16_t>(sign | 0x7c00u | (abs > 0x7f800000u ? 0x200u : 0u));
+    }
+    /** 超出半精度范围,溢出为无穷 **/
+    if (abs >= 0x477ff000u) {
+        return static_cast<uint16_t>(sign | 0x7c00u);
+    }
+    /** 半精度次正规数(含0) **/
+    if (abs < 0x38800000u) {
+        if (abs < 0x33000000u) {
+            return static_cast<uint16_t>(sign);
+        }
+        uint32_t mantissa = (abs & 0x007fffffu) | 0x00800000u;
+        int shift = 126 - static_cast<int>(abs >> 23);
+        uint32_t half = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (rest > halfway || (rest == halfway && (half & 1u))) {
+            ++half;
+        }
+        return static_cast<uint16_t>(sign | half);
+    }
+    /** 正规数:调整指数偏置,按低13位就近舍入到偶数(进位可自然进入指数) **/
+    uint32_t half = (abs - 0x38000000u) >> 13;
+    uint32_t rest = abs & 0x1fffu;
+    if (rest > 0x1000u || (rest == 0x1000u && (half & 1u))) {
+        ++half;
+    }
+    return static_cast<uint16_t>(sign | half);
+}
+
+static void encode_fp16_generic(const float *pSrc, uint16_t *pDst, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        pDst[i] = float_to_half(pSrc[i]);
+    }
+}
+
+/**
+ * F16C实现,每次转换8个float
+ */
+__attribute__((target("avx,f16c")))
+static void encode_fp16_f16c(const float *pSrc, uint16_t *pDst, size_t size) {
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        __m128i half = _mm256_cvtps_ph(_mm256_loadu_ps(pSrc + i), _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(pDst + i), half);
+    }
+    encode_fp16_generic(pSrc + i, pDst + i, size - i);
+}
+
+static float encode_int8_generic(const float *pSrc, int8_t *pDst, size_t size) {
+    float maxAbs = 0.0f;
+    for (size_t i = 0; i < size; ++i) {
+        maxAbs = std::max(maxAbs, std::fabs(pSrc[i]));
+    }
+    float scale = maxAbs / 127.0f;
+    float invScale = maxAbs > 0.0f ? 127.0f / maxAbs : 0.0f;
+    for (size_t i = 0; i < size; ++i) {
+        pDst[i] = static_cast<int8_t>(std::nearbyint(pSrc[i] * invScale));
+    }
+    return scale;
+}
+
+/**
+ * AVX2实现,先求绝对值最大值,再每次量化8个float
+ */
+__attribute__((target("avx2")))
+static float encode_int8_avx2(const float *pSrc, int8_t *pDst, size_t size) {
+    const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+    __m256 maxVec = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        maxVec = _mm256_max_ps(maxVec, _mm256_and_ps(_mm256_loadu_ps(pSrc + i), absMask));
+    }
+    __m128 max4 = _mm_max_ps(_mm256_castps256_ps128(maxVec), _mm256_extractf128_ps(maxVec, 1));
+    max4 = _mm_max_ps(max4, _mm_movehl_ps(max4, max4));
+    max4 = _mm_max_ss(max4, _mm_shuffle_ps(max4, max4, 1));
+    float maxAbs = _mm_cvtss_f32(max4);
+    for (size_t j = i; j < size; ++j) {
+        maxAbs = std::max(maxAbs, std::fabs(pSrc[j]));
+    }
+
+    float scale = maxAbs / 127.0f;
+    float invScale = maxAbs > 0.0f ? 127.0f / maxAbs : 0.0f;
+    const __m256 invVec = _mm256_set1_ps(invScale);
+    for (i = 0; i + 8 <= size; i += 8) {
+        /** 默认舍入模式为就近舍入到偶数,与标量实现的nearbyint一致 **/
+        __m256i q = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_loadu_ps(pSrc + i), invVec));
+        __m128i q16 = _mm_packs_epi32(_mm256_castsi256_si128(q), _mm256_extracti128_si256(q, 1));
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(pDst + i), _mm_packs_epi16(q16, q16));
+    }
+    for (; i < size; ++i) {
+        pDst[i] = static_cast<int8_t>(std::nearbyint(pSrc[i] * invScale));
+    }
+    return scale;
+}
+
+typedef void (*EncodeFp16Func)(const float *, uint16_t *, size_t);
+
+typedef float (*EncodeInt8Func)(const float *, int8_t *, size_t);
+
+/**
+ * 按CPU支持情况选择实现,只在首次调用时判断一次
+ */
+static EncodeFp16Func select_encode_fp16() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx") && __builtin_cpu_supports("f16c")) {
+        return encode_fp16_f16c;
+    }
+    return encode_fp16_generic;
+}
+
+static EncodeInt8Func select_encode_int8() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return encode_int8_avx2;
+    }
+    return encode_int8_generic;
+}
+
+/**
+ * float转半精度
+ */
+void encode_fp16(const float *pSrc, uint16_t *pDst, size_t size) {
+    static const EncodeFp16Func func = select_encode_fp16();
+    func(pSrc, pDst, size);
+}
+
+/**
+ * 对称int8量化
+ */
+float encode_int8(const float *pSrc, int8_t *pDst, size_t size) {
+    static const EncodeInt8Func func = select_encode_int8();
+    return func(pSrc, pDst, size);
+}
@@ -0,0 +1,24 @@
+//
+// Created by adai on 2019/01/16.
+//
+
+#ifndef DDUP_MOGU_ENCODE_H
+#define DDUP_MOGU_ENCODE_H
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * float转半精度(IEEE 754 binary16,就近舍入到偶数)
+ * 运行时按CPU支持情况选择F16C/标量实现
+ */
+void encode_fp16(const float *pSrc, uint16_t *pDst, size_t size);
+
+/**
+ * 对称int8量化: q = round(x / scale), scale = max|x| / 127
+ * 运行时按CPU支持情况选择AVX2/标量实现
+ * @return 本向量的scale,反量化为 q * scale; 全零向量返回0
+ */
+float encode_int8(const float *pSrc, int8_t *pDst, size_t size);
+
+#endif //DDUP_MOGU_ENCODE_H
@@ -0,0 +1,87 @@
+//
+// Created by adai on 2019/01/24.
+//
+
+#include "mogu_fold_input.h"
+
+#include <iostream>
+
+#include <samples/slog.hpp>
+
+using namespace InferenceEngine;
+
+/**
+ * 折叠输入归一化
+ */
+int fold_input_normalization(CNNNetwork &network, const std::string &inputName, const float *channelMean,
+                             float invScale, int swapRB) {
+    InputsDataMap inputs = network.getInputsInfo();
+    auto input = inputs.find(inputName);
+    if (input == inputs.end()) {
+        return 0;
+    }
+    std::map<std::string, CNNLayerPtr> &consumers = input->second->getInputData()->getInputTo();
+    if (consumers.size() != 1) {
+        slog::warn << "input " << inputName << " feeds " << consumers.size() << " layers, can not fold mean"
+                   << slog::endl;
+        return 0;
+    }
+    auto conv = std::dynamic_pointer_cast<ConvolutionLayer>(consumers.begin()->second);
+    if (!conv || conv->_group != 1 || !conv->_weights || conv->_weights->precision() != Precision::FP32) {
+        slog::warn << "first layer " << consumers.begin()->second->name
+                   << " is not a plain fp32 convolution, can not fold mean" << slog::endl;
+        return 0;
+    }
+    const size_t channels = 3;
+    size_t outChannels = conv->_out_depth;
+    size_t weightsSize = conv->_weights->size();
+    if (outChannels == 0 || weightsSize % (outChannels * channels) != 0) {
+        slog::warn << "unexpected weights shape of " << conv->name << ", can not fold mean" << slog::endl;
+        return 0;
+    }
+    if (conv->_biases && (conv->_biases->size() != outChannels || conv->_biases->precision() != Precision::FP32)) {
+        slog::warn << "unexpected biases shape of " << conv->name << ", can not fold mean" << slog::endl;
+        return 0;
+    }
+    /** 有padding时原网络在边界补的是归一化后的0(即补均值),折叠后补原始像素0,均值非零时边界输出会改变 **/
+    bool zeroMean = channelMean[0] == 0 && channelMean[1] == 0 && channelMean[2] == 0;
+    if (!zeroMean &&
+        (conv->_padding_x || conv->_padding_y || conv->_pads_end.at(X_AXIS) || conv->_pads_end.at(Y_AXIS))) {
+        slog::warn << conv->name << " pads its input, can not fold mean" << slog::endl;
+        return 0;
+    }
+    size_t kernelSize = weightsSize / (outChannels * channels);
+
+    TBlob<float>::Ptr weights = std::make_shared<TBlob<float>>(TensorDesc(Precision::FP32, {weightsSize}, Layout::C));
+    TBlob<float>::Ptr biases = std::make_shared<TBlob<float>>(TensorDesc(Precision::FP32, {outChannels}, Layout::C));
+    weights->allocate();
+    biases->allocate();
+    const float *pWeights = conv->_weights->cbuffer().as<const float *>();
+    const float *pBiases = conv->_biases ? conv->_biases->cbuffer().as<const float *>() : nullptr;
+    float *pNewWeights = weights->buffer().as<float *>();
+    float *pNewBiases = biases->buffer().as<float *>();
+
+    /** 权重布局为[输出通道][输入通道][kernel] **/
+    for (size_t o = 0; o < outChannels; ++o) {
+        double shift = 0;
+        for (size_t c = 0; c < channels; ++c) {
+            const float *pSrc = pWeights + (o * channels + c) * kernelSize;
+            size_t rawChannel = swapRB ? channels - 1 - c : c;
+            float *pDst = pNewWeights + (o * channels + rawChannel) * kernelSize;
+            double sum = 0;
+            for (size_t k = 0; k < kernelSize; ++k) {
+                pDst[k] = pSrc[k] * invScale;
+                sum += pSrc[k];
+            }
+            shift += sum * channelMean[c];
+        }
+        pNewBiases[o] = static_cast<float>((pBiases ? pBiases[o] : 0.0f) - invScale * shift);
+    }
+
+    conv->_weights = weights;
+    conv->_biases = biases;
+    conv->blobs["weights"] = weights;
+    conv->blobs["biases"] = biases;
+    slog::info << "folded input normalization into " << conv->name << slog::endl;
+    return 1;
+}
@@ -0,0 +1,26 @@
+//
+// Created by adai on 2019/01/24.
+//
+
+#ifndef DDUP_MOGU_FOLD_INPUT_H
+#define DDUP_MOGU_FOLD_INPUT_H
+
+#include <string>
+
+#include <inference_engine.hpp>
+
+/**
+ * 把输入归一化(x - mean) * invScale和BGR->RGB通道交换折叠进输入层后的第一个卷积
+ * 折叠后网络直接接收BGR原始像素:W' = W * invScale(输入通道按需交换), b' = b - invScale * sum(W * mean)
+ * 新的权重/偏置单独分配,不修改共享的权重映射
+ * 均值须为每个通道的常数,逐像素变化的均值图不能折叠,由调用方判断;
+ * 卷积有padding且均值非零时边界的补零语义会变化(原为补均值,折叠后为补0),此时不折叠
+ * @param channelMean 网络通道顺序(RGB)的各通道均值
+ * @param swapRB 网络输入是否为RGB,是则把BGR原始像素的通道交换折叠进权重
+ * @return 输入层后只有一个3通道输入,非分组的FP32卷积且折叠结果与原网络一致时折叠并返回1,
+ *         否则不修改网络并返回0
+ */
+int fold_input_normalization(InferenceEngine::CNNNetwork &network, const std::string &inputName,
+                             const float *channelMean, float invScale, int swapRB);
+
+#endif //DDUP_MOGU_FOLD_INPUT_H
@@ -0,0 +1,74 @@
+//
+// Created by adai on 2019/01/08.
+//
+
+#include "mogu_infer_pool.h"
+
+/**
+ * 预先创建请求
+ */
+void InferRequestPool::init(ExecutableNetwork &executableNetwork, int size) {
+    std::lock_guard<std::mutex> lock(mutex);
+    requests.clear();
+    idle.clear();
+    for (int i = 0; i < size; ++i) {
+        requests.push_back(executableNetwork.CreateInferRequestPtr());
+    }
+    idle = requests;
+}
+
+/**
+ * 借出一个空闲请求
+ */
+InferRequest::Ptr InferRequestPool::acquire() {
+    std::unique_lock<std::mutex> lock(mutex);
+    available.wait(lock, [this] { return !idle.empty(); });
+    InferRequest::Ptr request = idle.back();
+    idle.pop_back();
+    return request;
+}
+
+/**
+ * 归还请求
+ */
+void InferRequestPool::release(const InferRequest::Ptr &request) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        idle.push_back(request);
+    }
+    /** 可能有等待多个请求的调用者,需全部唤醒重新判断 **/
+    available.notify_all();
+}
+
+/**
+ * 一次借出多个空闲请求
+ */
+void InferRequestPool::acquire(int num, std::vector<InferRequest::Ptr> &out) {
+    std::unique_lock<std::mutex> lock(mutex);
+    available.wait(lock, [this, num] { return static_cast<int>(idle.size()) >= num; });
+    for (int i = 0; i < num; ++i) {
+        out.push_back(idle.back());
+        idle.pop_back();
+    }
+}
+
+/**
+ * 归还多个请求
+ */
+void InferRequestPool::release(const std::vector<InferRequest::Ptr> &requests) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        idle.insert(idle.end(), requests.begin(), requests.end());
+    }
+    available.notify_all();
+}
+
+/**
+ * 借出一个自动归还的请求
+ */
+std::shared_ptr<InferRequest> InferRequestPool::lease() {
+    InferRequest::Ptr request = acquire();
+    return std::shared_ptr<InferRequest>(request.get(), [this, request](InferRequest *) {
+        release(request);
+    });
+}
@@ -0,0 +1,82 @@
+//
+// Created by adai on 2019/01/08.
+//
+
+#ifndef DDUP_MOGU_INFER_POOL_H
+#define DDUP_MOGU_INFER_POOL_H
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+
+#include <inference_engine.hpp>
+
+using namespace InferenceEngine;
+
+/**
+ * 推断请求池
+ * 创建引擎时预先构建固定数目的请求(连同其输入输出blob),推断时借出,结束后归还
+ */
+class InferRequestPool {
+public:
+    /**
+     * 预先创建请求
+     */
+    void init(ExecutableNetwork &executableNetwork, int size);
+
+    /**
+     * 借出一个空闲请求,池中无空闲请求时阻塞等待
+     */
+    InferRequest::Ptr acquire();
+
+    /**
+     * 一次借出num个空闲请求,空闲请求不足时阻塞等待
+     * 多个请求一起借出,避免多个调用者各持有一部分请求而互相等待
+     */
+    void acquire(int num, std::vector<InferRequest::Ptr> &out);
+
+    /**
+     * 归还请求
+     */
+    void release(const InferRequest::Ptr &request);
+
+    /**
+     * 归还多个请求
+     */
+    void release(const std::vector<InferRequest::Ptr> &requests);
+
+    /**
+     * 借出一个空闲请求,最后一个引用释放时自动归还
+     * 可交给输出结果持有,使结果直接引用请求的输出blob;请求池须比借出的请求活得更久
+     */
+    std::shared_ptr<InferRequest> lease();
+
+    /**
+     * 池大小
+     */
+    int size() const {
+        return static_cast<int>(requests.size());
+    }
+
+    /**
+     * 池中全部请求(用于创建时统一设置回调等)
+     */
+    const std::vector<InferRequest::Ptr> &all() const {
+        return requests;
+    }
+
+private:
+    /**
+     * 池中全部请求
+     */
+    std::vector<InferRequest::Ptr> requests;
+    /**
+     * 空闲请求栈
+     */
+    std::vector<InferRequest::Ptr> idle;
+    std::mutex mutex;
+    std::condition_variable available;
+};
+
+#endif //DDUP_MOGU_INFER_POOL_H
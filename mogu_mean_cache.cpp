@@ -0,0 +1,156 @@
+//
+// Created by adai on 2019/01/14.
+//
+
+#include "mogu_mean_cache.h"
+#include "mogu_preprocess.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+#include <samples/slog.hpp>
+
+MeanTable::~MeanTable() {
+    if (region) {
+        munmap(region, regionSize);
+    }
+}
+
+MeanCache &MeanCache::instance() {
+    static MeanCache cache;
+    return cache;
+}
+
+/**
+ * 获取均值表
+ */
+std::shared_ptr<const MeanTable> MeanCache::get(const std::string &meanFile, int width, int height, int channel,
+                                                int interleaved, float scale, int node) {
+    char key[80];
+    snprintf(key, sizeof(key), "|%d_%d_%d|%d|%a|%d", width, height, channel, interleaved, scale, node);
+    std::string cacheKey = meanFile + key;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    std::shared_ptr<const MeanTable> table = tables[cacheKey].lock();
+    if (!table) {
+        table = load(meanFile, width, height, channel, interleaved, scale);
+        if (table) {
+            tables[cacheKey] = table;
+        } else {
+            tables.erase(cacheKey);
+        }
+    }
+    return table;
+}
+
+/**
+ * 读取均值文件并预计算均值表
+ * 均值文件格式: int32 高,宽,通道数, 随后为R,G,B三个平面的float
+ */
+std::shared_ptr<const MeanTable> MeanCache::load(const std::string &meanFile, int width, int height, int channel,
+                                                 int interleaved, float scale) {
+    if (channel != 3) {
+        slog::err << "mean file only supports 3 channels: " << meanFile << slog::endl;
+        return nullptr;
+    }
+    int fd = open(meanFile.c_str(), O_RDONLY);
+    if (fd < 0) {
+        slog::err << "can not open mean file: " << meanFile << slog::endl;
+        return nullptr;
+    }
+    struct stat fileStat;
+    size_t meanSize = (size_t) width * height * channel;
+    size_t fileSize = fstat(fd, &fileStat) == 0 ? (size_t) fileStat.st_size : 0;
+    if (fileSize < 3 * sizeof(int)) {
+        slog::err << "mean file has no header: " << meanFile << slog::endl;
+        close(fd);
+        return nullptr;
+    }
+
+    /** 均值文件只读映射,进程间共享page cache **/
+    void *file = mmap(nullptr, fileSize, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (file == MAP_FAILED) {
+        slog::err << "can not mmap mean file: " << meanFile << slog::endl;
+        return nullptr;
+    }
+    const int *header = static_cast<const int *>(file);
+    const float *planarMean = reinterpret_cast<const float *>(header + 3);
+    int fileH = header[0], fileW = header[1];
+    size_t fileMeanSize = fileH > 0 && fileW > 0 && header[2] > 0 ? (size_t) fileH * fileW * header[2] : 0;
+    if (!fileMeanSize || fileSize < 3 * sizeof(int) + fileMeanSize * sizeof(float)) {
+        slog::err << "mean file is truncated: " << meanFile << slog::endl;
+        munmap(file, fileSize);
+        return nullptr;
+    }
+
+    /** 均值文件与缩放后图片大小不同(如分辨率分桶)时,逐通道双线性重采样 **/
+    std::vector<float> resampled;
+    if (header[2] == channel && fileMeanSize != meanSize) {
+        resampled.resize(meanSize);
+        size_t filePlane = (size_t) fileH * fileW;
+        size_t plane = (size_t) width * height;
+        for (int c = 0; c < channel; ++c) {
+            cv::Mat src(fileH, fileW, CV_32FC1, const_cast<float *>(planarMean + c * filePlane));
+            cv::Mat dst(height, width, CV_32FC1, resampled.data() + c * plane);
+            cv::resize(src, dst, dst.size(), 0, 0, cv::INTER_LINEAR);
+        }
+        planarMean = resampled.data();
+    } else if (fileMeanSize != meanSize) {
+        if (fileMeanSize < meanSize) {
+            slog::err << "mean file is smaller than " << width << "x" << height << "x" << channel << ": "
+                      << meanFile << slog::endl;
+            munmap(file, fileSize);
+            return nullptr;
+        }
+        slog::warn << "mean file shape " << header[0] << "_" << header[1] << "_" << header[2]
+                   << " differs from network input, reading first " << meanSize << " values" << slog::endl;
+    }
+
+    std::shared_ptr<MeanTable> table = std::make_shared<MeanTable>();
+    table->width = width;
+    table->height = height;
+    table->interleaved = interleaved;
+    table->invScale = 1.0f / scale;
+
+    /** 预计算mean * invScale 及其翻转表,写入后改为只读 **/
+    table->regionSize = 2 * meanSize * sizeof(float);
+    void *region = mmap(nullptr, table->regionSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (region == MAP_FAILED) {
+        munmap(file, fileSize);
+        return nullptr;
+    }
+    table->region = region;
+    float *scaledMean = static_cast<float *>(region);
+    layout_mean(planarMean, width, height, interleaved, 0, table->invScale, scaledMean);
+    layout_mean(planarMean, width, height, interleaved, 1, table->invScale, scaledMean + meanSize);
+    mprotect(region, table->regionSize, PROT_READ);
+    table->scaledMean = scaledMean;
+    table->scaledMeanMirror = scaledMean + meanSize;
+
+    /** 各通道均值 **/
+    size_t planeSize = (size_t) width * height;
+    for (int c = 0; c < 3; ++c) {
+        double sum = 0;
+        for (size_t i = 0; i < planeSize; ++i) {
+            sum += planarMean[c * planeSize + i];
+        }
+        table->channelMean[c] = static_cast<float>(sum / planeSize);
+        float tolerance = 1e-5f * std::max(1.0f, std::fabs(table->channelMean[c]));
+        for (size_t i = 0; i < planeSize && table->uniform; ++i) {
+            if (std::fabs(planarMean[c * planeSize + i] - table->channelMean[c]) > tolerance) {
+                table->uniform = 0;
+            }
+        }
+    }
+
+    munmap(file, fileSize);
+    return table;
+}
@@ -0,0 +1,87 @@
+//
+// Created by adai on 2019/01/14.
+//
+
+#ifndef DDUP_MOGU_MEAN_CACHE_H
+#define DDUP_MOGU_MEAN_CACHE_H
+
+#include <map>
+#include <mutex>
+#include <memory>
+#include <string>
+
+/**
+ * 预计算的均值表,只读,同一均值文件和网络几何的所有网络共享一份
+ */
+struct MeanTable {
+    MeanTable() = default;
+    ~MeanTable();
+    MeanTable(const MeanTable &) = delete;
+    MeanTable &operator=(const MeanTable &) = delete;
+
+    /**
+     * 缩放后图片的宽高
+     */
+    int width = 0, height = 0;
+    /**
+     * 是否为RGB交错布局(NHWC),否则为RGB平面布局(NCHW)
+     */
+    int interleaved = 1;
+    /**
+     * 归一化系数的倒数
+     */
+    float invScale = 1.0f;
+    /**
+     * mean * invScale,按网络输入布局排列;翻转视图使用水平翻转后的表
+     */
+    const float *scaledMean = nullptr;
+    const float *scaledMeanMirror = nullptr;
+    /**
+     * 各通道均值(RGB,未乘invScale)
+     */
+    float channelMean[3] = {0};
+    /**
+     * 均值图是否每个通道内处处相同,是则channelMean与逐像素均值等价
+     */
+    int uniform = 1;
+
+private:
+    friend class MeanCache;
+    /**
+     * 两张表所在的只读匿名映射
+     */
+    void *region = nullptr;
+    size_t regionSize = 0;
+};
+
+/**
+ * 进程级均值缓存
+ * 均值文件通过mmap读取,按(文件路径,几何,布局,归一化系数,NUMA节点)缓存预计算的均值表;
+ * 所有使用者释放后均值表随之释放
+ */
+class MeanCache {
+public:
+    static MeanCache &instance();
+
+    /**
+     * 获取均值表,失败时返回nullptr
+     * @param width,height 缩放后图片的宽高
+     * @param node 不小于0时为该NUMA节点单独保留一份,应在绑定到该节点的线程中调用,使均值表首次访问发生在本节点
+     */
+    std::shared_ptr<const MeanTable> get(const std::string &meanFile, int width, int height, int channel,
+                                         int interleaved, float scale, int node = -1);
+
+private:
+    MeanCache() = default;
+
+    /**
+     * 读取均值文件并预计算均值表
+     */
+    std::shared_ptr<const MeanTable> load(const std::string &meanFile, int width, int height, int channel,
+                                          int interleaved, float scale);
+
+    std::mutex mutex;
+    std::map<std::string, std::weak_ptr<const MeanTable>> tables;
+};
+
+#endif //DDUP_MOGU_MEAN_CACHE_H
@@ -0,0 +1,232 @@
+//
+// Created by adai on 2019/01/17.
+//
+
+#include "mogu_model_registry.h"
+
+#include <thread>
+
+/**
+ * 注册表本身不析构,后台更新线程可安全访问
+ */
+ModelRegistry &ModelRegistry::instance() {
+    static ModelRegistry *registry = new ModelRegistry();
+    return *registry;
+}
+
+/**
+ * 获取设备插件
+ */
+ModelRegistry::DevicePlugin &ModelRegistry::device_plugin(const Config &config) {
+    std::unique_ptr<DevicePlugin> &devicePlugin = plugins[config.targetDevice];
+    if (!devicePlugin) {
+        std::unique_ptr<DevicePlugin> created(new DevicePlugin());
+        // todo 绝对路径
+        InferenceEnginePluginPtr engine_ptr = PluginDispatcher({"", "../../../lib/intel64", ""}).getSuitablePlugin(
+                config.targetDevice);
+        created->plugin = InferencePlugin(engine_ptr);
+        if (config.targetDevice == TargetDevice::eCPU) {
+            /** CPU扩展层实现,整个进程只加载一次 **/
+            created->plugin.AddExtension(std::make_shared<Extensions::Cpu::CpuExtensions>());
+            /** 线程绑定为插件级设置,只在创建时设置一次,避免各模型互相覆盖 **/
+            created->bindThread = config.bindThread;
+            created->plugin.SetConfig({{PluginConfigParams::KEY_CPU_BIND_THREAD,
+                                        config.bindThread ? PluginConfigParams::YES : PluginConfigParams::NO}});
+        }
+        devicePlugin = std::move(created);
+    } else if (config.targetDevice == TargetDevice::eCPU && devicePlugin->bindThread != config.bindThread) {
+        slog::warn << "bindThread=" << config.bindThread << " ignored, plugin already created with bindThread="
+                   << devicePlugin->bindThread << slog::endl;
+    }
+
+    /** 自定义扩展库按路径只加载一次 **/
+    if (!config.extensionLib.empty() &&
+        extensions.insert(std::make_pair(config.targetDevice, config.extensionLib)).second) {
+        devicePlugin->plugin.AddExtension(make_so_pointer<IExtension>(config.extensionLib));
+        slog::info << "Extension loaded: " << config.extensionLib << slog::endl;
+    }
+    return *devicePlugin;
+}
+
+/**
+ * 获取设备插件
+ */
+InferencePlugin ModelRegistry::plugin(const Config &config) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return device_plugin(config).plugin;
+}
+
+/**
+ * 加载可执行网络
+ */
+ExecutableNetwork ModelRegistry::load_network(const Config &config, CNNNetwork network,
+                                              const std::map<std::string, std::string> &loadConfig) {
+    DevicePlugin *devicePlugin;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        devicePlugin = &device_plugin(config);
+    }
+    std::lock_guard<std::mutex> loadLock(devicePlugin->loadMutex);
+    return devicePlugin->plugin.LoadNetwork(network, loadConfig);
+}
+
+/**
+ * 构建并预热模型
+ */
+std::shared_ptr<Openvino_Net> ModelRegistry::build(Config &config) {
+    /** 最后一个引用释放时交给析构线程,引用可能在推断线程或完成回调中释放 **/
+    std::shared_ptr<Openvino_Net> net(new Openvino_Net(config), [](Openvino_Net *pNet) {
+        ModelRegistry::instance().retire(pNet);
+    });
+    try {
+        /** 创建时已完成预热 **/
+        if (!net->create_inf_engine()) {
+            return nullptr;
+        }
+    } catch (const std::exception &error) {
+        slog::err << "build model " << config.modelName << " failed: " << error.what() << slog::endl;
+        return nullptr;
+    }
+    return net;
+}
+
+/**
+ * 退役模型,首次退役时启动析构线程
+ */
+void ModelRegistry::retire(Openvino_Net *pNet) {
+    std::lock_guard<std::mutex> lock(retireMutex);
+    if (!retireThread) {
+        retireThread = 1;
+        std::thread([this]() {
+            std::unique_lock<std::mutex> retireLock(retireMutex);
+            while (true) {
+                retireCond.wait(retireLock, [this]() {
+                    return !retired.empty();
+                });
+                Openvino_Net *pRetired = retired.front();
+                retired.pop_front();
+                /** 析构时等待借出的请求完成,不持有锁 **/
+                retireLock.unlock();
+                delete pRetired;
+                retireLock.lock();
+            }
+        }).detach();
+    }
+    retired.push_back(pNet);
+    retireCond.notify_one();
+}
+
+/**
+ * 创建并注册模型
+ */
+std::shared_ptr<Openvino_Net> ModelRegistry::create(const std::string &name, Config &config) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto item = models.find(name);
+        if (item != models.end() && item->second.net) {
+            return item->second.net;
+        }
+    }
+    /** 创建引擎较慢,不持有注册表锁 **/
+    std::shared_ptr<Openvino_Net> net = build(config);
+    if (!net) {
+        return nullptr;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    ModelEntry &entry = models[name];
+    /** 并发创建同名模型时保留先注册的,本次构建在引用释放后退役 **/
+    if (entry.net) {
+        return entry.net;
+    }
+    entry.net = net;
+    entry.version = ++entry.latestVersion;
+    return entry.net;
+}
+
+/**
+ * 热更新模型
+ */
+int ModelRegistry::reload(const std::string &name, const Config &config) {
+    int version;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto item = models.find(name);
+        if (item == models.end() || !item->second.net) {
+            version = 0;
+        } else {
+            version = ++item->second.latestVersion;
+        }
+    }
+    /** 模型不存在时同步创建 **/
+    if (!version) {
+        Config createConfig = config;
+        return create(name, createConfig) ? this->version(name) : 0;
+    }
+
+    Config buildConfig = config;
+    std::thread([this, name, buildConfig, version]() mutable {
+        std::shared_ptr<Openvino_Net> net = build(buildConfig);
+        if (!net) {
+            slog::err << "reload " << name << " v" << version << " failed, keeping current version" << slog::endl;
+            return;
+        }
+        /** 旧版本在进行中的推断释放引用后退役 **/
+        std::shared_ptr<Openvino_Net> old;
+        bool published = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ModelEntry &entry = models[name];
+            /** 期间已发布更新的版本(或模型已注销)时丢弃本次构建 **/
+            if (!entry.net || version <= entry.version) {
+                old = net;
+            } else {
+                old = entry.net;
+                entry.net = net;
+                entry.version = version;
+                published = true;
+            }
+        }
+        old.reset();
+        slog::info << "model " << name << " v" << version << (published ? " published" : " discarded")
+                   << slog::endl;
+    }).detach();
+    return version;
+}
+
+/**
+ * 查找模型
+ */
+std::shared_ptr<Openvino_Net> ModelRegistry::find(const std::string &name) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto item = models.find(name);
+    return item == models.end() ? nullptr : item->second.net;
+}
+
+/**
+ * 当前发布的版本号
+ */
+int ModelRegistry::version(const std::string &name) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto item = models.find(name);
+    return item == models.end() || !item->second.net ? 0 : item->second.version;
+}
+
+/**
+ * 注销模型
+ */
+int ModelRegistry::release(const std::string &name) {
+    std::shared_ptr<Openvino_Net> net;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto item = models.find(name);
+        if (item == models.end() || !item->second.net) {
+            return 0;
+        }
+        net = item->second.net;
+        /** 保留版本号,重新创建时版本继续递增 **/
+        item->second.net.reset();
+    }
+    /** 进行中的推断释放引用后退役 **/
+    net.reset();
+    return 1;
+}
@@ -0,0 +1,126 @@
+//
+// Created by adai on 2019/01/17.
+//
+
+#ifndef DDUP_MOGU_MODEL_REGISTRY_H
+#define DDUP_MOGU_MODEL_REGISTRY_H
+
+#include <map>
+#include <set>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <string>
+
+#include "mogu_openvino.h"
+
+/**
+ * 进程级模型注册表
+ * 每种设备只创建一个插件,CPU扩展和自定义扩展库只加载一次,线程绑定在插件创建时统一设置;
+ * 所有模型的可执行网络都由同一个插件加载,按模型名称管理;
+ * 模型可热更新:新版本在后台构建并预热后原子发布,旧版本在进行中的推断结束后在后台释放
+ */
+class ModelRegistry {
+public:
+    static ModelRegistry &instance();
+
+    /**
+     * 获取设备插件,首次获取时创建插件,加载CPU扩展并设置线程绑定
+     * @param config 提供设备,线程绑定和扩展库;线程绑定与已创建的插件不一致时以插件为准
+     */
+    InferencePlugin plugin(const Config &config);
+
+    /**
+     * 通过设备插件加载可执行网络,同一插件上的加载串行进行
+     */
+    ExecutableNetwork load_network(const Config &config, CNNNetwork network,
+                                   const std::map<std::string, std::string> &loadConfig);
+
+    /**
+     * 创建并注册模型,同名模型已存在时直接返回已有模型
+     * @return 创建失败时返回nullptr
+     */
+    std::shared_ptr<Openvino_Net> create(const std::string &name, Config &config);
+
+    /**
+     * 热更新模型:在后台构建并预热新版本,完成后原子替换旧版本;模型不存在时同步创建
+     * 同一模型并发更新时只发布最新发起的版本,构建失败时保留旧版本
+     * @return 本次更新的版本号,同步创建失败时返回0
+     */
+    int reload(const std::string &name, const Config &config);
+
+    /**
+     * 查找模型,不存在时返回nullptr
+     * 返回的引用在推断期间保持模型有效,即使模型已被注销或替换
+     */
+    std::shared_ptr<Openvino_Net> find(const std::string &name);
+
+    /**
+     * 当前发布的版本号,模型不存在时返回0
+     */
+    int version(const std::string &name);
+
+    /**
+     * 注销模型,进行中的推断结束后在后台释放
+     * @return 是否存在该模型
+     */
+    int release(const std::string &name);
+
+private:
+    ModelRegistry() = default;
+
+    /**
+     * 一个模型的发布状态
+     */
+    struct ModelEntry {
+        std::shared_ptr<Openvino_Net> net;
+        /**
+         * 已发布的版本,最新发起的版本
+         */
+        int version = 0, latestVersion = 0;
+    };
+
+    /**
+     * 构建并预热一个模型,失败时返回nullptr
+     * 返回的模型在最后一个引用释放时退役
+     */
+    static std::shared_ptr<Openvino_Net> build(Config &config);
+
+    /**
+     * 退役模型:最后一个引用释放时由删除器调用,交给析构线程析构,避免在推断线程中析构
+     */
+    void retire(Openvino_Net *pNet);
+
+    /**
+     * 设备插件及其线程绑定设置
+     */
+    struct DevicePlugin {
+        InferencePlugin plugin;
+        int bindThread = 1;
+        std::mutex loadMutex;
+    };
+
+    /**
+     * 获取设备插件,调用时需持有mutex
+     */
+    DevicePlugin &device_plugin(const Config &config);
+
+    std::mutex mutex;
+    std::map<TargetDevice, std::unique_ptr<DevicePlugin>> plugins;
+    /**
+     * 已加载的扩展库(设备,路径)
+     */
+    std::set<std::pair<TargetDevice, std::string>> extensions;
+    std::map<std::string, ModelEntry> models;
+
+    /**
+     * 待析构的模型,由析构线程按退役顺序析构
+     */
+    std::mutex retireMutex;
+    std::condition_variable retireCond;
+    std::deque<Openvino_Net *> retired;
+    int retireThread = 0;
+};
+
+#endif //DDUP_MOGU_MODEL_REGISTRY_H
@@ -0,0 +1,112 @@
+//
+// Created by adai on 2019/01/27.
+//
+
+#include "mogu_multi_model.h"
+#include "mogu_buffer_pool.h"
+
+#include <algorithm>
+
+/**
+ * 一个预处理签名的共享输入
+ */
+struct SharedInput {
+    float *pData;
+    size_t capacity;
+};
+
+/**
+ * 拷贝结果,供重复出现的模型使用
+ */
+static void copy_output(Output &src, Output &dst) {
+    dst.names = src.names;
+    dst.reset();
+    for (auto &item : src.tensors) {
+        OutputTensor &from = item.second;
+        OutputTensor &to = dst.tensors[item.first];
+        to.shape = from.shape;
+        to.encoding = from.encoding;
+        to.fp16 = from.fp16;
+        to.int8 = from.int8;
+        to.int8Scale = from.int8Scale;
+        if (from.data) {
+            size_t dim = static_cast<size_t>(from.getTotalDim());
+            std::copy(from.data, from.data + dim, to.allocate(dim));
+        }
+    }
+}
+
+/**
+ * 多模型推断
+ * 按签名依次预处理并立即启动该签名下的模型,后续签名的预处理与已启动的推断重叠;
+ * 共享预处理的模型按网络地址顺序借出请求,并发调用之间不会互相等待对方持有的请求;
+ * 不能共享预处理的模型在共享输入的推断启动后于调用线程中推断;
+ * 重复出现的模型只推断一次,结果拷贝给其余位置;全部推断结束后才释放共享输入
+ */
+void inference_multi(const std::vector<std::shared_ptr<Openvino_Net>> &nets, std::vector<Output> &outputs,
+                     unsigned char *pImageHead, int imageW, int imageH) {
+    outputs.resize(nets.size());
+    std::map<std::string, SharedInput> inputs;
+    std::vector<std::function<void()>> pending;
+    /** 每个网络第一次出现的位置 **/
+    std::map<const Openvino_Net *, size_t> first;
+    std::exception_ptr error;
+    try {
+        /** 挑出共享预处理的模型,按网络地址排序 **/
+        std::vector<size_t> shared, unshared;
+        for (size_t i = 0; i < nets.size(); ++i) {
+            if (!first.emplace(nets[i].get(), i).second) {
+                continue;
+            }
+            if (nets[i]->preprocess_signature().empty()) {
+                unshared.push_back(i);
+            } else {
+                shared.push_back(i);
+            }
+        }
+        std::sort(shared.begin(), shared.end(), [&nets](size_t a, size_t b) {
+            return std::less<const Openvino_Net *>()(nets[a].get(), nets[b].get());
+        });
+        for (size_t i : shared) {
+            std::string signature = nets[i]->preprocess_signature();
+            auto item = inputs.find(signature);
+            if (item == inputs.end()) {
+                SharedInput input;
+                size_t floats = (nets[i]->preprocess_bytes() + sizeof(float) - 1) / sizeof(float);
+                input.pData = BufferPool::instance().acquire(floats, input.capacity);
+                item = inputs.emplace(signature, input).first;
+                nets[i]->preprocess(pImageHead, imageW, imageH, input.pData);
+            }
+            pending.push_back(nets[i]->start_preprocessed(outputs[i], item->second.pData));
+        }
+        /** 不能共享预处理的模型在调用线程中推断,与已启动的推断并发 **/
+        for (size_t i : unshared) {
+            nets[i]->inference(outputs[i], pImageHead, imageW, imageH);
+        }
+    } catch (...) {
+        error = std::current_exception();
+    }
+    for (auto &wait : pending) {
+        try {
+            wait();
+        } catch (...) {
+            if (!error) {
+                error = std::current_exception();
+            }
+        }
+        /** 尽早归还请求 **/
+        wait = nullptr;
+    }
+    for (auto &item : inputs) {
+        BufferPool::instance().release(item.second.pData, item.second.capacity);
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    for (size_t i = 0; i < nets.size(); ++i) {
+        size_t source = first[nets[i].get()];
+        if (source != i) {
+            copy_output(outputs[source], outputs[i]);
+        }
+    }
+}
@@ -0,0 +1,20 @@
+//
+// Created by adai on 2019/01/27.
+//
+
+#ifndef DDUP_MOGU_MULTI_MODEL_H
+#define DDUP_MOGU_MULTI_MODEL_H
+
+#include "mogu_openvino.h"
+
+/**
+ * 多模型推断:同一张图片交给多个模型
+ * 预处理签名相同的模型共享一次缩放和归一化,各模型并发推断;不能共享预处理的模型在调用线程中推断
+ * 任一模型推断失败时,全部推断结束后抛出第一个异常
+ * @param nets 模型,不能为空指针
+ * @param outputs 按nets顺序返回各模型的结果
+ */
+void inference_multi(const std::vector<std::shared_ptr<Openvino_Net>> &nets, std::vector<Output> &outputs,
+                     unsigned char *pImageHead, int imageW, int imageH);
+
+#endif //DDUP_MOGU_MULTI_MODEL_H
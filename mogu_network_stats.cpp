@@ -0,0 +1,93 @@
+//
+// Created by adai on 2019/01/23.
+//
+
+#include "mogu_network_stats.h"
+
+#include <fstream>
+#include <sstream>
+#include <iostream>
+
+#include <samples/slog.hpp>
+
+using namespace InferenceEngine;
+
+/**
+ * 读取统计文件
+ */
+int read_network_stats(const std::string &statsFile, NetworkStatsMap &stats) {
+    std::ifstream file(statsFile);
+    if (!file) {
+        slog::err << "can not open stats file: " << statsFile << slog::endl;
+        return 0;
+    }
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        std::istringstream fields(line);
+        std::string name;
+        size_t channels = 0;
+        if (!(fields >> name >> channels) || channels == 0) {
+            slog::err << "bad stats line in " << statsFile << ": " << line << slog::endl;
+            return 0;
+        }
+        NetworkNodeStatsPtr nodeStats = std::make_shared<NetworkNodeStats>();
+        nodeStats->_minOutputs.resize(channels);
+        nodeStats->_maxOutputs.resize(channels);
+        for (size_t c = 0; c < channels; ++c) {
+            fields >> nodeStats->_minOutputs[c];
+        }
+        for (size_t c = 0; c < channels; ++c) {
+            fields >> nodeStats->_maxOutputs[c];
+        }
+        if (!fields) {
+            slog::err << "truncated stats of layer " << name << " in " << statsFile << slog::endl;
+            return 0;
+        }
+        stats[name] = nodeStats;
+    }
+    return 1;
+}
+
+/**
+ * 写出统计文件
+ */
+int write_network_stats(const std::string &statsFile, const NetworkStatsMap &stats) {
+    std::ofstream file(statsFile);
+    if (!file) {
+        slog::err << "can not write stats file: " << statsFile << slog::endl;
+        return 0;
+    }
+    /** 最小/最大值需要原样读回 **/
+    file.precision(9);
+    file << "# layer channels min... max..." << std::endl;
+    for (const auto &item : stats) {
+        const NetworkNodeStats &nodeStats = *item.second;
+        file << item.first << " " << nodeStats._minOutputs.size();
+        for (float value : nodeStats._minOutputs) {
+            file << " " << value;
+        }
+        for (float value : nodeStats._maxOutputs) {
+            file << " " << value;
+        }
+        file << std::endl;
+    }
+    return file.good() ? 1 : 0;
+}
+
+/**
+ * 把统计信息设置到网络
+ */
+int apply_network_stats(CNNNetwork &network, const NetworkStatsMap &stats) {
+    ICNNNetworkStats *pStats = nullptr;
+    ResponseDesc resp;
+    StatusCode status = static_cast<ICNNNetwork &>(network).getStats(&pStats, &resp);
+    if (status != StatusCode::OK || !pStats) {
+        slog::err << "network does not support stats: " << resp.msg << slog::endl;
+        return 0;
+    }
+    pStats->setNodesStats(stats);
+    return 1;
+}
@@ -0,0 +1,36 @@
+//
+// Created by adai on 2019/01/23.
+//
+
+#ifndef DDUP_MOGU_NETWORK_STATS_H
+#define DDUP_MOGU_NETWORK_STATS_H
+
+#include <string>
+
+#include <inference_engine.hpp>
+#include <ie_icnn_network_stats.hpp>
+
+/**
+ * INT8校准统计文件
+ * 每层一行: 层名 通道数 各通道最小值 各通道最大值,以空格分隔(层名不能含空白字符)
+ */
+
+/**
+ * 读取统计文件
+ * @return 读取成功返回1
+ */
+int read_network_stats(const std::string &statsFile, InferenceEngine::NetworkStatsMap &stats);
+
+/**
+ * 写出统计文件
+ * @return 写出成功返回1
+ */
+int write_network_stats(const std::string &statsFile, const InferenceEngine::NetworkStatsMap &stats);
+
+/**
+ * 把统计信息设置到网络,加载后CPU插件按统计量运行INT8
+ * @return 网络支持统计信息时返回1
+ */
+int apply_network_stats(InferenceEngine::CNNNetwork &network, const InferenceEngine::NetworkStatsMap &stats);
+
+#endif //DDUP_MOGU_NETWORK_STATS_H
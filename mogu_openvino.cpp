@@ -3,6 +3,20 @@
 //
 
 #include "mogu_openvino.h"
+#include "mogu_preprocess.h"
+#include "mogu_mean_cache.h"
+#include "mogu_model_registry.h"
+#include "mogu_cpu_topology.h"
+#include "mogu_weights_cache.h"
+#include "mogu_network_stats.h"
+#include "mogu_fold_input.h"
+#include "mogu_prune_ir.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <sstream>
 
 /**
  * 检查配置信息是否完整
@@ -27,78 +41,271 @@ inline int assertConfig(Config &config) {
 }
 
 /**
- * 数组对应下标相减
+ * 设置可选参数
  */
-inline float
-sub_mean(cv::Mat &image, const float *mean_arr, int x, int y, int width, float &scale, int c, int mean_delta_a) {
-    unsigned char r = image.at<cv::Vec3b>(y, x)[c];
-    float mean_r = mean_arr[y * width + x + mean_delta_a * width * width];
-    return (r - mean_r) / scale;
+int Config::setOption(const std::string &key, const std::string &value) {
+    if (key == "requestNum") {
+        int num = atoi(value.c_str());
+        if (num > 0) {
+            requestNum = num;
+        }
+        return 1;
+    }
+    if (key == "batchImages") {
+        int num = atoi(value.c_str());
+        if (num > 0) {
+            batchImages = num;
+        }
+        return 1;
+    }
+    if (key == "pluginPreprocess") {
+        pluginPreprocess = atoi(value.c_str());
+        return 1;
+    }
+    if (key == "swapRB") {
+        swapRB = atoi(value.c_str());
+        return 1;
+    }
+    if (key == "batchWaitUs") {
+        int us = atoi(value.c_str());
+        if (us >= 0) {
+            batchWaitUs = us;
+        }
+        return 1;
+    }
+    if (key == "borrowOutput") {
+        borrowOutput = atoi(value.c_str());
+        return 1;
+    }
+    if (key == "replicas") {
+        int num = atoi(value.c_str());
+        if (num >= 0) {
+            replicas = num;
+        }
+        return 1;
+    }
+    if (key == "warmUpRounds") {
+        warmUpRounds = atoi(value.c_str());
+        return 1;
+    }
+    if (key == "warmUpMaxRounds") {
+        warmUpMaxRounds = atoi(value.c_str());
+        return 1;
+    }
+    if (key == "warmUpTolerance") {
+        warmUpTolerance = static_cast<float>(atof(value.c_str()));
+        return 1;
+    }
+    if (key == "numa") {
+        numa = atoi(value.c_str());
+        return 1;
+    }
+    if (key == "bindThread") {
+        bindThread = atoi(value.c_str());
+        return 1;
+    }
+    if (key == "extension") {
+        extensionLib = value;
+        return 1;
+    }
+    if (key == "reduction") {
+        if (value == "mean") {
+            reduction = ViewReduction::MEAN;
+        } else if (value == "max") {
+            reduction = ViewReduction::MAX;
+        } else if (value == "l2mean") {
+            reduction = ViewReduction::L2_MEAN;
+        } else {
+            reduction = ViewReduction::NONE;
+        }
+        return 1;
+    }
+    if (key == "inferenceMode") {
+        inferenceMode = value == "latency" ? InferenceMode::LATENCY : InferenceMode::THROUGHPUT;
+        return 1;
+    }
+    if (key == "latencyParts") {
+        int num = atoi(value.c_str());
+        if (num >= 0) {
+            latencyParts = num;
+        }
+        return 1;
+    }
+    if (key == "earlyExitCosine") {
+        earlyExitCosine = static_cast<float>(atof(value.c_str()));
+        return 1;
+    }
+    if (key == "int8Stats") {
+        int8Stats = value;
+        return 1;
+    }
+    if (key == "featureLayers") {
+        featureLayers.clear();
+        std::stringstream names(value);
+        std::string name;
+        while (std::getline(names, name, ',')) {
+            if (!name.empty()) {
+                featureLayers.push_back(name);
+            }
+        }
+        return 1;
+    }
+    if (key == "buckets") {
+        buckets.clear();
+        std::stringstream sizes(value);
+        std::string size;
+        while (std::getline(sizes, size, ',')) {
+            int first = 0, second = 0;
+            if (sscanf(size.c_str(), "%d_%d", &first, &second) == 2 && first > 0 && second > 0) {
+                buckets.emplace_back(first, second);
+            }
+        }
+        return 1;
+    }
+    if (key == "width_height") {
+        int first = 0, second = 0;
+        if (sscanf(value.c_str(), "%d_%d", &first, &second) == 2 && first > 0 && second > 0) {
+            pImageInfo->width = first;
+            pImageInfo->height = second;
+        }
+        return 1;
+    }
+    if (key == "foldMean") {
+        foldMean = atoi(value.c_str());
+        return 1;
+    }
+    if (key == "calibrate") {
+        calibrate = atoi(value.c_str());
+        return 1;
+    }
+    if (key == "outputEncoding") {
+        if (value == "fp16") {
+            outputEncoding = OutputEncoding::FP16;
+        } else if (value == "int8") {
+            outputEncoding = OutputEncoding::INT8;
+        } else {
+            outputEncoding = OutputEncoding::FP32;
+        }
+        return 1;
+    }
+    if (key == "outputs") {
+        outputs.clear();
+        std::stringstream names(value);
+        std::string name;
+        while (std::getline(names, name, ',')) {
+            if (!name.empty()) {
+                outputs.push_back(name);
+            }
+        }
+        return 1;
+    }
+    return 0;
 }
 
 /**
- * 剪裁图片
+ * 解析"key=value;key=value"形式的参数
  */
-inline void
-crop(const float *psrc, float *&pdst, int &x_offset, int &y_offset, int &width, int &height, int &originW,
-     int &originH) {
-    for (int y = 0; y < height; ++y) {
-        for (int x = 0; x < width * 3; x += 3) {
-            int r_index = y * width * 3 + x;
-            int g_index = r_index + 1;
-            int b_index = r_index + 2;
-            int r_offset_index = (y + y_offset) * originW + x / 3 + x_offset;
-            int g_offset_index = (y + y_offset) * originW + x / 3 + x_offset + originW * originH;
-            int b_offset_index = (y + y_offset) * originW + x / 3 + x_offset + originW * originW * 2;
-            *(pdst + r_index) = *(psrc + r_offset_index);
-            *(pdst + g_index) = *(psrc + g_offset_index);
-            *(pdst + b_index) = *(psrc + b_offset_index);
+void Config::addOverrides(const std::string &options) {
+    std::stringstream items(options);
+    std::string item;
+    while (std::getline(items, item, ';')) {
+        size_t pos = item.find('=');
+        if (pos == std::string::npos || pos == 0) {
+            continue;
         }
+        overrides.emplace_back(item.substr(0, pos), item.substr(pos + 1));
+    }
+}
+
+OutputTensor::OutputTensor(OutputTensor &&other) noexcept
+        : shape(std::move(other.shape)), data(other.data), encoding(other.encoding), fp16(std::move(other.fp16)),
+          int8(std::move(other.int8)), int8Scale(std::move(other.int8Scale)), capacity(other.capacity),
+          owner(std::move(other.owner)) {
+    other.data = nullptr;
+    other.capacity = 0;
+}
+
+OutputTensor &OutputTensor::operator=(OutputTensor &&other) noexcept {
+    if (this != &other) {
+        reset();
+        shape = std::move(other.shape);
+        data = other.data;
+        encoding = other.encoding;
+        fp16 = std::move(other.fp16);
+        int8 = std::move(other.int8);
+        int8Scale = std::move(other.int8Scale);
+        capacity = other.capacity;
+        owner = std::move(other.owner);
+        other.data = nullptr;
+        other.capacity = 0;
+    }
+    return *this;
+}
+
+/**
+ * 准备结果缓冲区
+ */
+float *OutputTensor::allocate(size_t size) {
+    if (capacity >= size) {
+        return data;
     }
-    pdst += width * height * 3;
+    reset();
+    data = BufferPool::instance().acquire(size, capacity);
+    return data;
 }
 
 /**
- * 图片翻转
+ * 引用外部内存作为结果
  */
-inline void flip(float *&psrc, float *&pdst, int tuple_w, int tuple_h) {
-    for (int y = 0; y < tuple_h; ++y) {
-        for (int x = 0; x < tuple_w * 3 / 2; x += 3) {
-            int rline_index = x;
-            int gline_index = x + 1;
-            int bline_index = x + 2;
-            int rows = tuple_w * 3;
-            int r_mirror = rows - rline_index - 1 - 2;
-            int g_mirror = rows - rline_index - 1 - 1;
-            int b_mirror = rows - rline_index - 1;
-            int pre_r_index = y * tuple_w * 3 + rline_index;
-            int pre_g_index = y * tuple_w * 3 + gline_index;
-            int pre_b_index = y * tuple_w * 3 + bline_index;
-            int last_r_index = y * tuple_w * 3 + r_mirror;
-            int last_g_index = y * tuple_w * 3 + g_mirror;
-            int last_b_index = y * tuple_w * 3 + b_mirror;
-            *(pdst + pre_r_index) = *(psrc + last_r_index);
-            *(pdst + last_r_index) = *(psrc + pre_r_index);
-            *(pdst + pre_g_index) = *(psrc + last_g_index);
-            *(pdst + last_g_index) = *(psrc + pre_g_index);
-            *(pdst + pre_b_index) = *(psrc + last_b_index);
-            *(pdst + last_b_index) = *(psrc + pre_b_index);
+void OutputTensor::borrow(float *pData, std::shared_ptr<void> owner) {
+    reset();
+    data = pData;
+    this->owner = std::move(owner);
+}
+
+/**
+ * 编码结果
+ */
+void OutputTensor::encode(OutputEncoding encoding, const float *pSrc) {
+    this->encoding = encoding;
+    if (!pSrc) {
+        pSrc = data;
+    }
+    size_t size = static_cast<size_t>(getTotalDim());
+    if (encoding == OutputEncoding::FP16) {
+        fp16.resize(size);
+        encode_fp16(pSrc, fp16.data(), size);
+    } else if (encoding == OutputEncoding::INT8) {
+        /** 每个向量单独量化 **/
+        size_t rows = shape.empty() ? 1 : shape[0];
+        size_t rowDim = rows ? size / rows : 0;
+        int8.resize(size);
+        int8Scale.resize(rows);
+        for (size_t r = 0; r < rows; ++r) {
+            int8Scale[r] = encode_int8(pSrc + r * rowDim, int8.data() + r * rowDim, rowDim);
         }
     }
-    psrc += tuple_w * tuple_h * 3;
-    pdst += tuple_w * tuple_h * 3;
 }
 
 /**
- * 构建插件
- * @param plugin 插件
+ * 释放结果
  */
-inline void create_plugin(InferencePlugin &plugin, Config &config) {
-    // todo 绝对路径
-    InferenceEnginePluginPtr engine_ptr = PluginDispatcher({"", "../../../lib/intel64", ""}).getSuitablePlugin(
-            config.targetDevice);
-    plugin = InferencePlugin(engine_ptr);
-    plugin.SetConfig({{PluginConfigParams::KEY_CPU_BIND_THREAD, PluginConfigParams::YES}});
+void OutputTensor::reset() {
+    if (capacity) {
+        BufferPool::instance().release(data, capacity);
+    }
+    data = nullptr;
+    capacity = 0;
+    owner.reset();
+}
+
+/**
+ * 把连续的u8图片包装为NHWC的blob,不拷贝数据
+ */
+inline Blob::Ptr wrap_image(const cv::Mat &image) {
+    TensorDesc tensorDesc(Precision::U8, {1, (size_t) image.channels(), (size_t) image.rows, (size_t) image.cols},
+                          Layout::NHWC);
+    return make_shared_blob<uint8_t>(tensorDesc, image.data);
 }
 
 /**
@@ -111,14 +318,17 @@ int Openvino_Net::read_config() {
 
     FILE *pConfigFile = fopen(configDir, "r");
     if (!pConfigFile) {
-        return 1;
+        slog::err << "can not open config file " << static_cast<const char *>(configDir) << slog::endl;
+        return 0;
     }
 
     int readNum = 0;
     /** 读取图片三维 **/
     int width, height, channel;
     readNum = fscanf(pConfigFile, "width_height_channel=%d_%d_%d\n", &width, &height, &channel);
-    if (!readNum) {
+    if (readNum != 3) {
+        slog::err << "bad width_height_channel in " << static_cast<const char *>(configDir) << slog::endl;
+        fclose(pConfigFile);
         return 0;
     }
     if (width > 0 && height > 0 && channel > 0) {
@@ -130,27 +340,13 @@ int Openvino_Net::read_config() {
     /** 读取图片翻转信息 **/
     readNum = fscanf(pConfigFile, "flip=%d\n", &config.pImageInfo->flip);
 
-    /** 读取均值文件 **/
+    /** 读取均值文件路径,均值表在应用调用方参数后从进程级缓存获取 **/
     // todo doudi
-    char buffer[512];
-    int meanSize;
-    int meanH, meanW, meanC;
-    readNum = fscanf(pConfigFile, "meanFile=%s\n", buffer);
+    char buffer[512] = {0};
+    readNum = fscanf(pConfigFile, "meanFile=%511s\n", buffer);
     std::string meanFileStr(buffer);
     if (!meanFileStr.empty()) {
         config.pImageInfo->meanFile = meanFileStr;
-        FILE *pMeanFile = fopen(buffer, "rb");
-
-        readNum = fread(&meanH, 4, 1, pMeanFile);
-        readNum = fread(&meanW, 4, 1, pMeanFile);
-        readNum = fread(&meanC, 4, 1, pMeanFile);
-        meanSize = width * height * channel;
-
-        //todo malloc
-        meanArr = (float *) malloc(sizeof(float) * meanSize);
-        if (fread((void *) meanArr, sizeof(float), (size_t) meanSize, pMeanFile) != meanSize) {
-            return 0;
-        }
     }
 
     /** 读取归一化系数 **/
@@ -170,8 +366,69 @@ int Openvino_Net::read_config() {
         config.pImageInfo->corpPoint[i][1] = yPoint;
     }
 
+    /** 裁剪窗口必须落在缩放后的图片内 **/
+    for (int i = 0; i < config.pImageInfo->cropNum; ++i) {
+        int maxX = config.pImageInfo->height - config.pImageInfo->corpSize_W;
+        int maxY = config.pImageInfo->width - config.pImageInfo->cropSize_H;
+        int *point = config.pImageInfo->corpPoint[i];
+        if (point[0] < 0 || point[0] > maxX || point[1] < 0 || point[1] > maxY) {
+            slog::warn << "crop point " << point[0] << "_" << point[1] << " out of image, clamped" << slog::endl;
+            point[0] = std::min(std::max(point[0], 0), maxX);
+            point[1] = std::min(std::max(point[1], 0), maxY);
+        }
+    }
+
+    /** 读取可选参数,缺省时保留Config中的默认值 **/
+    char key[64], value[256];
+    while (fscanf(pConfigFile, " %63[^=]=%255[^\n]\n", key, value) == 2) {
+        if (!config.setOption(key, value)) {
+            slog::warn << "unknown config option: " << key << slog::endl;
+        }
+    }
+
     fclose(pConfigFile);
-    return 0;
+    return 1;
+}
+
+/**
+ * 获取按网络输入布局预计算的均值表,同一均值文件和几何的网络共享一份
+ * 几何取应用.config和调用方参数之后的最终值,分桶网络因此得到分桶大小的均值表
+ */
+int Openvino_Net::load_mean_table() {
+    if (config.pImageInfo->meanFile.empty()) {
+        return 1;
+    }
+    int interleaved = config.inputLayout != Layout::NCHW;
+    meanTable = MeanCache::instance().get(config.pImageInfo->meanFile, config.pImageInfo->height,
+                                          config.pImageInfo->width, config.pImageInfo->channel, interleaved,
+                                          config.pImageInfo->scale);
+    if (!meanTable) {
+        slog::err << "can not load mean file " << config.pImageInfo->meanFile << " of " << config.modelName
+                  << slog::endl;
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * 把均值表还原为各通道的均值图(未乘invScale),设置为插件预处理的按像素均值
+ */
+void Openvino_Net::set_mean_image(PreProcessInfo &preProcess) {
+    size_t width = static_cast<size_t>(meanTable->width);
+    size_t height = static_cast<size_t>(meanTable->height);
+    size_t planeSize = width * height;
+    float scale = meanTable->invScale != 0.0f ? 1.0f / meanTable->invScale : 1.0f;
+    for (size_t c = 0; c < 3; ++c) {
+        TBlob<float>::Ptr meanImage = std::make_shared<TBlob<float>>(
+                TensorDesc(Precision::FP32, {height, width}, Layout::HW));
+        meanImage->allocate();
+        float *pDst = meanImage->buffer().as<float *>();
+        for (size_t i = 0; i < planeSize; ++i) {
+            size_t index = meanTable->interleaved ? i * 3 + c : c * planeSize + i;
+            pDst[i] = meanTable->scaledMean[index] * scale;
+        }
+        preProcess.setMeanImageForChannel(meanImage, c);
+    }
 }
 
 /**
@@ -188,11 +445,81 @@ int Openvino_Net::read_net() {
     std::string xmlDirStr(xmlDir);
     std::string binDirStr(binDir);
 
-    /** 读取模型文件 **/
-    reader.ReadNetwork(xmlDirStr);
-    reader.ReadWeights(binDirStr);
+    /** 读取模型文件,指定特征层时先裁剪掉特征层下游的层 **/
+    if (config.featureLayers.empty()) {
+        reader.ReadNetwork(xmlDirStr);
+    } else {
+        std::ifstream xmlFile(xmlDirStr);
+        std::string xml((std::istreambuf_iterator<char>(xmlFile)), std::istreambuf_iterator<char>());
+        std::string pruned;
+        if (!xmlFile || !prune_ir(xml, config.featureLayers, pruned)) {
+            slog::err << "can not prune model to feature layers: " << xmlDirStr << slog::endl;
+            return 0;
+        }
+        reader.ReadNetwork(pruned.data(), pruned.size());
+        /** 未配置默认输出层时取特征层,校准模式仍取全部层 **/
+        if (config.outputs.empty() && !config.calibrate) {
+            config.outputs = config.featureLayers;
+        }
+    }
+    /** 权重通过进程级缓存内存映射,映射失败时退回整体读取 **/
+    weights = WeightsCache::instance().get(binDirStr);
+    if (weights) {
+        reader.SetWeights(weights->blob());
+    } else {
+        reader.ReadWeights(binDirStr);
+    }
     CNNNetwork network = reader.getNetwork();
 
+    /** 校准模式:所有计算层都作为输出层 **/
+    if (config.calibrate) {
+        for (const CNNLayerPtr &layer : network) {
+            if (layer->type != "Input" && layer->type != "Const") {
+                network.addOutput(layer->name);
+            }
+        }
+    }
+    /** 网络输入大小与视图大小不一致时(如分辨率分桶)按视图大小reshape **/
+    int cropNum = config.pImageInfo->cropNum;
+    size_t viewH = static_cast<size_t>(cropNum > 0 ? config.pImageInfo->cropSize_H : config.pImageInfo->width);
+    size_t viewW = static_cast<size_t>(cropNum > 0 ? config.pImageInfo->corpSize_W : config.pImageInfo->height);
+    ICNNNetwork::InputShapes inputShapes = network.getInputShapes();
+    bool reshape = false;
+    for (auto &item : inputShapes) {
+        SizeVector &dims = item.second;
+        if (dims.size() == 4 && (dims[2] != viewH || dims[3] != viewW)) {
+            dims[2] = viewH;
+            dims[3] = viewW;
+            reshape = true;
+        }
+    }
+    if (reshape) {
+        try {
+            network.reshape(inputShapes);
+        } catch (const std::exception &error) {
+            slog::err << "can not reshape " << config.modelName << " to " << viewW << "x" << viewH << ": "
+                      << error.what() << slog::endl;
+            return 0;
+        }
+    }
+
+    /** 特征层可能是另一个特征层的上游,需显式加为输出层 **/
+    for (const auto &name : config.featureLayers) {
+        network.addOutput(name);
+    }
+    /** 加载INT8统计量 **/
+    if (!config.int8Stats.empty()) {
+        std::string statsFile = config.int8Stats;
+        if (statsFile[0] != '/') {
+            statsFile = config.modelDir + "/" + statsFile;
+        }
+        NetworkStatsMap stats;
+        if (!read_network_stats(statsFile, stats) || !apply_network_stats(network, stats)) {
+            return 0;
+        }
+        slog::info << "loaded int8 stats of " << stats.size() << " layers from " << statsFile << slog::endl;
+    }
+
     /** 设置输入精度和布局 **/
     InputsDataMap inputInfo = network.getInputsInfo();
     for (auto &inputInfoItem : inputInfo) {
@@ -200,15 +527,67 @@ int Openvino_Net::read_net() {
         if (!inputData) {
             return 0;
         }
+        if (config.pluginPreprocess) {
+            /** 插件预处理:输入原始u8图片(ROI),由插件完成缩放和减均值/归一化 **/
+            inputData->setPrecision(Precision::U8);
+            inputData->setLayout(Layout::NHWC);
+            PreProcessInfo &preProcess = inputData->getPreProcess();
+            preProcess.setResizeAlgorithm(ResizeAlgorithm::RESIZE_BILINEAR);
+            if (meanTable) {
+                preProcess.init(3);
+                for (size_t c = 0; c < 3; ++c) {
+                    preProcess[c]->stdScale = config.pImageInfo->scale;
+                }
+                if (meanTable->uniform) {
+                    /** 各通道均值处处相同,按通道减均值与主机端一致 **/
+                    for (size_t c = 0; c < 3; ++c) {
+                        preProcess[c]->meanValue = meanTable->channelMean[c];
+                    }
+                    preProcess.setVariant(MeanVariant::MEAN_VALUE);
+                } else if (config.pImageInfo->cropNum == 0) {
+                    /** 没有裁剪时网络输入即整张图片,按像素减均值图 **/
+                    set_mean_image(preProcess);
+                    if (config.pImageInfo->flip) {
+                        slog::warn << "pluginPreprocess subtracts the unmirrored mean image from mirrored views, "
+                                   << "results differ from host preprocessing" << slog::endl;
+                    }
+                } else {
+                    slog::warn << "pluginPreprocess approximates the per-pixel mean of " << config.pImageInfo->meanFile
+                               << " by channel means, results differ from host preprocessing" << slog::endl;
+                    for (size_t c = 0; c < 3; ++c) {
+                        preProcess[c]->meanValue = meanTable->channelMean[c];
+                    }
+                    preProcess.setVariant(MeanVariant::MEAN_VALUE);
+                }
+            }
+            continue;
+        }
+        /** 归一化折叠进第一个卷积:输入BGR原始像素,无法精确折叠时退回主机端归一化 **/
+        if (config.foldMean && meanTable && !meanTable->uniform) {
+            slog::warn << "mean file " << config.pImageInfo->meanFile
+                       << " varies per pixel, foldMean is ignored" << slog::endl;
+            config.foldMean = 0;
+        }
+        if (config.foldMean) {
+            const float zeroMean[3] = {0, 0, 0};
+            const float *pMean = meanTable ? meanTable->channelMean : zeroMean;
+            float invScale = meanTable ? meanTable->invScale : 1.0f;
+            if (fold_input_normalization(network, inputInfoItem.first, pMean, invScale, config.swapRB)) {
+                inputData->setPrecision(Precision::U8);
+                inputData->setLayout(Layout::NHWC);
+                continue;
+            }
+            config.foldMean = 0;
+        }
         inputData->setPrecision(config.inputPrecision);
         inputData->setLayout(config.inputLayout);
     }
 
-    /** 计算batch_size 大小 **/
-    size_t batchSize = 1;
-    int cropNum = config.pImageInfo->cropNum;
-    batchSize = cropNum == 0 ? batchSize : cropNum;
-    batchSize = config.pImageInfo->flip == 1 ? 2 * batchSize : batchSize;
+    /** 计算batch_size 大小,合并批处理时为多张图片的视图总数;插件预处理时每个请求只处理一个视图 **/
+    size_t batchSize = static_cast<size_t>(config.viewNum() * config.batchImages);
+    if (config.pluginPreprocess) {
+        batchSize = 1;
+    }
     network.setBatchSize(batchSize);
 
     /** 设置输出精度和布局 **/
@@ -219,24 +598,26 @@ int Openvino_Net::read_net() {
             return 0;
         }
         outputData->setPrecision(config.outputPrecision);
-        outputData->setLayout(config.outputLayout);
+        /** 输出布局只对二维输出(如特征,分类概率)生效,其他输出保持网络原布局 **/
+        if (outputData->getTensorDesc().getDims().size() == 2) {
+            outputData->setLayout(config.outputLayout);
+        }
     }
     return 1;
 }
 
 /**
  * 图片增强逻辑
+ * 按裁剪窗口逐个生成视图(先全部裁剪视图,再全部翻转视图),归一化后直接写入输入blob;开启foldMean时写入原始像素
  */
-void Openvino_Net::ex_pic(float *phead, Config &config, unsigned char *pImageHead, int imageW, int imageH) {
+void Openvino_Net::ex_pic(void *phead, Config &config, unsigned char *pImageHead, int imageW, int imageH,
+                          const MeanTable *pMeanTable, const int *pViews, int viewCount) {
 
-    float *tmp = phead;
     int width = config.pImageInfo->height;
     int height = config.pImageInfo->width;
-    int channel = config.pImageInfo->channel;
     int targetW = config.pImageInfo->corpSize_W;
     int targetH = config.pImageInfo->cropSize_H;
     int cropNum = config.pImageInfo->cropNum;
-    float d_mean[width * height * channel];
 
     /** 读取图片 **/
     cv::Mat image(imageH, imageW, CV_8UC3, pImageHead);
@@ -249,49 +630,36 @@ void Openvino_Net::ex_pic(float *phead, Config &config, unsigned char *pImageHea
         resized = image;
     }
 
+    /** 没有均值文件时只做通道转换 **/
+    // todo 待完善均值,来源图片,网络所需图片三者之间的通道差异
+    const float *pMean = pMeanTable ? pMeanTable->scaledMean : nullptr;
+    const float *pMeanMirror = pMeanTable ? pMeanTable->scaledMeanMirror : nullptr;
+    float invScale = pMeanTable ? pMeanTable->invScale : 1.0f;
+    int planar = config.inputLayout == Layout::NCHW;
 
-    /** 从资源池读取均值数组 **/
-    if (meanArr) {
-        // todo 待完善均值,来源图片,网络所需图片三者之间的通道差异
-        for (int y = 0; y < height; ++y) {
-            for (int x = 0; x < width; ++x) {
-                float rs = sub_mean(resized, meanArr, x, y, width, config.pImageInfo->scale, 2, 0);
-                float gs = sub_mean(resized, meanArr, x, y, width, config.pImageInfo->scale, 1, 1);
-                float bs = sub_mean(resized, meanArr, x, y, width, config.pImageInfo->scale, 0, 2);
-                d_mean[y * width + x] = rs;
-                d_mean[y * width + x + width * height] = gs;
-                d_mean[y * width + x + width * height * 2] = bs;
-            }
-        }
-    } else {
-        for (int y = 0; y < resized.rows; ++y) {
-            for (int x = 0; x < resized.cols; ++x) {
-                d_mean[y * resized.cols + x] = resized.at<cv::Vec3b>(y, x)[2] * 1.0f;
-                d_mean[y * width + x + width * height] = resized.at<cv::Vec3b>(y, x)[1] * 1.0f;
-                d_mean[y * width + x + width * height * 2] = resized.at<cv::Vec3b>(y, x)[0] * 1.0f;
-            }
-        }
-    }
-
-    /** 释放大小转换的中间数据 **/
-    image.release();
-    resized.release();
-
-    /** 裁剪逻辑 **/
-    if (cropNum > 0) {
-        int x, y;
-        for (int i = 0; i < cropNum; ++i) {
-            x = config.pImageInfo->corpPoint[i][0];
-            y = config.pImageInfo->corpPoint[i][1];
-            crop(d_mean, phead, x, y, targetW, targetH, width, height);
-        }
-    }
-
-    /** 翻转逻辑 **/
-    if (config.pImageInfo->flip) {
-        for (int i = 0; i < cropNum; ++i) {
-            flip(tmp, phead, targetW, targetH);
+    /** 没有裁剪时整张图片作为一个视图 **/
+    int cropViews = cropNum > 0 ? cropNum : 1;
+    int viewW = cropNum > 0 ? targetW : width;
+    int viewH = cropNum > 0 ? targetH : height;
+    int flipNum = config.pImageInfo->flip ? 2 : 1;
+    int count = pViews ? viewCount : cropViews * flipNum;
+    size_t viewOffset = 0;
+    for (int k = 0; k < count; ++k) {
+        int view = pViews ? pViews[k] : k;
+        int mirror = view / cropViews;
+        int i = view % cropViews;
+        int x = cropNum > 0 ? config.pImageInfo->corpPoint[i][0] : 0;
+        int y = cropNum > 0 ? config.pImageInfo->corpPoint[i][1] : 0;
+        /** 归一化已折叠进第一个卷积时直接写入原始像素 **/
+        if (config.foldMean) {
+            write_view_u8(resized.ptr<unsigned char>(0), static_cast<int>(resized.step), x, y, viewW, viewH, mirror,
+                          static_cast<unsigned char *>(phead) + viewOffset);
+        } else {
+            write_view(resized.ptr<unsigned char>(0), static_cast<int>(resized.step), width, height, x, y, viewW,
+                       viewH, mirror, pMean, pMeanMirror, invScale, planar, static_cast<float *>(phead) + viewOffset,
+                       config.swapRB);
         }
+        viewOffset += static_cast<size_t>(viewW * viewH * 3);
     }
 }
 
@@ -299,54 +667,95 @@ void Openvino_Net::ex_pic(float *phead, Config &config, unsigned char *pImageHea
  * 填充请求数据
  */
 void
-Openvino_Net::fill_data(InferRequest &inferRequest, Config &config, unsigned char *pImageHead, int imageW, int imageH) {
-
-    /** 获取网络信息 **/
-    InputsDataMap inputInfo;
-    inputInfo = reader.getNetwork().getInputsInfo();
+Openvino_Net::fill_data(InferRequest &inferRequest, Config &config, unsigned char *pImageHead, int imageW, int imageH,
+                        int batchOffset, const MeanTable *pMeanTable, const int *pViews, int viewCount) {
+    /** 未指定时使用共享均值表 **/
+    if (!pMeanTable) {
+        pMeanTable = meanTable.get();
+    }
 
-    /** 遍历输入层信息,进行数据填充 **/
-    for (const auto &item : inputInfo) {
-        Blob::Ptr input = inferRequest.GetBlob(item.first);
+    /** 遍历输入层,进行数据填充 **/
+    for (const auto &inputName : inputNames) {
+        Blob::Ptr input = inferRequest.GetBlob(inputName);
+        /** 跳过batch中前batchOffset张视图 **/
+        size_t offset = input->size() / input->getTensorDesc().getDims()[0] * batchOffset;
+        if (config.foldMean) {
+            auto data = input->buffer().as<PrecisionTrait<Precision::U8>::value_type *>();
+            ex_pic(data + offset, config, pImageHead, imageW, imageH, pMeanTable, pViews, viewCount);
+            continue;
+        }
         // todo 将来可能需要使用泛型来指定精度
         auto data = input->buffer().as<PrecisionTrait<Precision::FP32>::value_type *>();
-        ex_pic(data, config, pImageHead, imageW, imageH);
+        ex_pic(data + offset, config, pImageHead, imageW, imageH, pMeanTable, pViews, viewCount);
+    }
+}
+
+/**
+ * 对已写入float结果的输出按需编码,编码后释放float结果
+ */
+static void encode_collected(OutputTensor &tensor, OutputEncoding encoding) {
+    tensor.encoding = encoding;
+    if (encoding != OutputEncoding::FP32) {
+        tensor.encode(encoding);
+        tensor.reset();
     }
 }
 
 /**
  * 收集推断结果
  */
-void Openvino_Net::collectOutPut(InferRequest &inferRequest, Config &config, Output &output) {
-
-    /** 获取网络信息 **/
-    OutputsDataMap outputInfo;
-    outputInfo = reader.getNetwork().getOutputsInfo();
-
-    /** 遍历输出层信息,进行结果填充 **/
-    // todo 当前版本只允许有一个输出...
-        for (const auto &item : outputInfo) {
-            Blob::Ptr outputBlob = inferRequest.GetBlob(item.first);
-            SizeVector shapesVector = outputBlob->getTensorDesc().getDims();
-            int i = 0;
-            size_t dim = 1;
-            for (auto shapeIteator = shapesVector.begin(); shapeIteator != shapesVector.end(); ++shapeIteator, ++i) {
-                dim = dim * *shapeIteator;
-                if (i > 3) {
-                    break;
-                } else {
-                    output.shape[i] = *shapeIteator;
-                }
-            }
-            // todo 将来可能需要使用泛型来指定精度
-            LockedMemory<void> memLocker = outputBlob->buffer();
-            auto data = memLocker.as<PrecisionTrait<Precision::FP32>::value_type *>();
+void Openvino_Net::collectOutPut(InferRequest &inferRequest, Config &config, Output &output, int batchOffset,
+                                 int batchCount, const std::shared_ptr<void> &owner) {
 
-            output.data = (float *) malloc(sizeof(float) * dim);
-            for (int j = 0; j < dim; ++j) {
-                * (output.data + j) = *(data + j);
-            }
+    if (output.names.empty()) {
+        output.names = defaultOutputs;
+    }
+    const std::vector<std::string> &names = output.names;
+    /** 丢弃上一次取出但本次未要求的输出层 **/
+    for (auto item = output.tensors.begin(); item != output.tensors.end();) {
+        if (std::find(names.begin(), names.end(), item->first) == names.end()) {
+            item = output.tensors.erase(item);
+        } else {
+            ++item;
+        }
+    }
+
+    /** 只遍历要求的输出层,进行结果填充 **/
+    for (const auto &outputName : names) {
+        Blob::Ptr outputBlob = inferRequest.GetBlob(outputName);
+        OutputTensor &tensor = output.tensors[outputName];
+        tensor.shape = outputBlob->getTensorDesc().getDims();
+        size_t dim = outputBlob->size();
+        /** 只取[batchOffset, batchOffset + batchCount)这几行结果 **/
+        size_t rowDim = dim / tensor.shape[0];
+        if (batchCount > 0) {
+            tensor.shape[0] = static_cast<size_t>(batchCount);
+            dim = rowDim * batchCount;
+        }
+        // todo 将来可能需要使用泛型来指定精度
+        LockedMemory<void> memLocker = outputBlob->buffer();
+        auto data = memLocker.as<PrecisionTrait<Precision::FP32>::value_type *>() + rowDim * batchOffset;
+
+        /** 多视图归约到池化缓冲区,再按需编码 **/
+        if (config.reduction != ViewReduction::NONE && tensor.shape[0] > 1) {
+            size_t views = tensor.shape[0];
+            tensor.shape[0] = 1;
+            reduce_views(data, views, rowDim, config.reduction, tensor.allocate(rowDim));
+            encode_collected(tensor, config.outputEncoding);
+            continue;
+        }
+        /** 需要编码时直接从输出blob编码,不保留float结果;否则直接引用输出blob,或拷贝到池化缓冲区 **/
+        if (config.outputEncoding != OutputEncoding::FP32) {
+            tensor.reset();
+            tensor.encode(config.outputEncoding, data);
+        } else if (owner) {
+            tensor.encoding = OutputEncoding::FP32;
+            tensor.borrow(data, owner);
+        } else {
+            tensor.encoding = OutputEncoding::FP32;
+            std::copy(data, data + dim, tensor.allocate(dim));
         }
+    }
 }
 
 /**
@@ -358,29 +767,1106 @@ int Openvino_Net::create_inf_engine() {
     if (!assertConfig(config)) {
         return 0;
     }
-    /** 初始化插件 **/
-    create_plugin(plugin, config);
-    /** 读取配置文件,填充/覆盖 缺省配置 **/
-    read_config();
+    /** 读取配置文件,填充/覆盖 缺省配置;配置不完整(如均值文件无法读取)时不创建 **/
+    if (!read_config()) {
+        return 0;
+    }
+    /** 调用方传入的参数优先于.config **/
+    for (const auto &item : config.overrides) {
+        if (!config.setOption(item.first, item.second)) {
+            slog::warn << "unknown config option: " << item.first << slog::endl;
+        }
+    }
+    if (!load_mean_table()) {
+        return 0;
+    }
+    /** 副本自行绑核,插件不能再把推断线程绑到别的核上 **/
+    if (config.replicas != 1 && config.bindThread) {
+        slog::warn << "bindThread is ignored when replicas is enabled" << slog::endl;
+        config.bindThread = 0;
+    }
+    /** 从模型注册表获取设备插件,同一设备的所有模型共享一个插件 **/
+    plugin = ModelRegistry::instance().plugin(config);
+    if (config.pluginPreprocess && config.batchImages > 1) {
+        slog::warn << "batchImages is ignored when pluginPreprocess is enabled" << slog::endl;
+        config.batchImages = 1;
+    }
+    if (config.pluginPreprocess && config.foldMean) {
+        slog::warn << "foldMean is ignored when pluginPreprocess is enabled" << slog::endl;
+        config.foldMean = 0;
+    }
+    if (config.replicas != 1 && (config.pluginPreprocess || config.batchImages > 1)) {
+        slog::warn << "batchImages and pluginPreprocess are ignored when replicas is enabled" << slog::endl;
+        config.pluginPreprocess = 0;
+        config.batchImages = 1;
+    }
+    init_adaptive_views();
     /** 读取模型网络信息 **/
-    read_net();
+    if (!read_net()) {
+        return 0;
+    }
     /** 插件通过网络信息加载称可执行网络 **/
-    executableNetwork = plugin.LoadNetwork(reader.getNetwork(), {});
+    std::map<std::string, std::string> loadConfig;
+    if (config.batchImages > 1 || (config.latencyParts > 1 && !config.pluginPreprocess) || !adaptiveViews.empty()) {
+        /** 合并批处理时开启动态batch,按实际合并的图片数推断;延迟模式和自适应TTA下每次只推断部分视图 **/
+        loadConfig[PluginConfigParams::KEY_DYN_BATCH_ENABLED] = PluginConfigParams::YES;
+        loadConfig[PluginConfigParams::KEY_DYN_BATCH_LIMIT] = std::to_string(config.viewNum() * config.batchImages);
+    }
+
+    /** 缓存输入输出层名称 **/
+    CNNNetwork network = reader.getNetwork();
+    for (const auto &item : network.getInputsInfo()) {
+        inputNames.push_back(item.first);
+    }
+    for (const auto &item : network.getOutputsInfo()) {
+        outputNames.push_back(item.first);
+        outputDims[item.first] = item.second->getTensorDesc().getDims();
+    }
+    /** 默认取出的输出层,未配置时取全部输出层 **/
+    for (const auto &name : config.outputs) {
+        if (std::find(outputNames.begin(), outputNames.end(), name) != outputNames.end()) {
+            defaultOutputs.push_back(name);
+        } else {
+            slog::warn << "unknown output layer: " << name << slog::endl;
+        }
+    }
+    if (defaultOutputs.empty()) {
+        defaultOutputs = outputNames;
+    }
+
+    /** 吞吐模式:每个物理核一个单线程副本 **/
+    if (config.replicas != 1) {
+        if (!create_replicas()) {
+            return 0;
+        }
+    } else {
+        executableNetwork = ModelRegistry::instance().load_network(config, network, loadConfig);
+
+        /** 预先创建请求池,插件预处理时每张图片的每个视图占用一个请求 **/
+        int poolSize = config.requestNum;
+        if (config.pluginPreprocess) {
+            poolSize *= config.viewNum();
+        }
+        requestPool.init(executableNetwork, poolSize);
+
+        /** 为每个请求设置一次完成回调,异步推断时按请求查找本次任务 **/
+        for (const auto &request : requestPool.all()) {
+            InferRequest *pRequest = request.get();
+            {
+                std::lock_guard<std::mutex> lock(asyncMutex);
+                asyncJobs[pRequest].request = request;
+            }
+            pRequest->SetCompletionCallback(std::function<void(InferRequest, StatusCode)>(
+                    [this, pRequest](InferRequest, StatusCode status) {
+                        on_async_complete(pRequest, status);
+                    }));
+        }
+    }
+
+    /** 分辨率分桶 **/
+    if (!config.buckets.empty() && !create_buckets()) {
+        return 0;
+    }
+
+    /** 预热,完成后才报告就绪 **/
+    warm_up();
+    return 1;
+}
+
+/**
+ * 析构
+ * 分桶网络先析构,再等待本网络借出的请求完成;副本随后作为最后声明的成员最先析构
+ */
+Openvino_Net::~Openvino_Net() {
+    bucketNets.clear();
+    for (const auto &request : requestPool.all()) {
+        try {
+            request->Wait(IInferRequest::WaitMode::RESULT_READY);
+        } catch (const std::exception &error) {
+            slog::warn << "wait request on destroy failed: " << error.what() << slog::endl;
+        }
+    }
+}
+
+/**
+ * 创建分辨率分桶的网络
+ * 每个分桶是一个独立的网络(各自的请求池或副本,均值表按分桶大小重采样),共享设备插件和权重映射
+ */
+int Openvino_Net::create_buckets() {
+    if (config.pImageInfo->cropNum > 0) {
+        slog::warn << "buckets are ignored when cropNum > 0" << slog::endl;
+        config.buckets.clear();
+        return 1;
+    }
+    for (const auto &bucket : config.buckets) {
+        if (bucket.first == config.pImageInfo->width && bucket.second == config.pImageInfo->height) {
+            continue;
+        }
+        /** 分桶网络持有自己的图片信息副本,随网络一起释放 **/
+        std::unique_ptr<ImageInfo> imageInfo(new ImageInfo(*config.pImageInfo));
+        Config bucketConfig = config;
+        bucketConfig.pImageInfo = imageInfo.get();
+        bucketConfig.overrides.emplace_back("width_height",
+                                            std::to_string(bucket.first) + "_" + std::to_string(bucket.second));
+        bucketConfig.overrides.emplace_back("buckets", "");
+        std::unique_ptr<Openvino_Net> net(new Openvino_Net(bucketConfig));
+        net->ownedImageInfo = std::move(imageInfo);
+        if (!net->create_inf_engine()) {
+            slog::err << "can not create bucket " << bucket.first << "_" << bucket.second << " of "
+                      << config.modelName << slog::endl;
+            return 0;
+        }
+        /** 均值表必须与分桶大小一致,否则减均值时越界读取 **/
+        if (net->meanTable && (net->meanTable->width != bucket.second || net->meanTable->height != bucket.first)) {
+            slog::err << "mean table " << net->meanTable->width << "_" << net->meanTable->height
+                      << " does not match bucket " << bucket.first << "_" << bucket.second << slog::endl;
+            return 0;
+        }
+        bucketNets.push_back(std::move(net));
+    }
+    return 1;
+}
+
+/**
+ * 按宽高比对数差选择网络
+ */
+Openvino_Net *Openvino_Net::route_bucket(int imageW, int imageH) {
+    if (bucketNets.empty() || imageW <= 0 || imageH <= 0) {
+        return nullptr;
+    }
+    double aspect = std::log(static_cast<double>(imageW) / imageH);
+    auto distance = [aspect](const Config &netConfig) {
+        /** pImageInfo->height为缩放后图片的宽 **/
+        return std::fabs(aspect - std::log(static_cast<double>(netConfig.pImageInfo->height) /
+                                           netConfig.pImageInfo->width));
+    };
+    Openvino_Net *best = nullptr;
+    double bestDistance = distance(config);
+    for (const auto &net : bucketNets) {
+        double netDistance = distance(net->config);
+        if (netDistance < bestDistance) {
+            best = net.get();
+            bestDistance = netDistance;
+        }
+    }
+    return best;
+}
+
+/**
+ * 创建绑核的网络副本
+ * 副本按物理核顺序依次绑定,每个副本单线程推断,副本数超过物理核数时多个副本共用一个核
+ */
+int Openvino_Net::create_replicas() {
+    std::vector<PhysicalCore> cores = physical_cores();
+    /** NUMA模式下副本在各节点间交替分布 **/
+    if (config.numa) {
+        cores = interleave_nodes(cores);
+        for (const auto &core : cores) {
+            for (int cpu : core.cpus) {
+                if (cpu >= static_cast<int>(cpuNodes.size())) {
+                    cpuNodes.resize(static_cast<size_t>(cpu + 1), -1);
+                }
+                cpuNodes[cpu] = core.node;
+            }
+        }
+    }
+    int replicaNum = config.replicas > 0 ? config.replicas : static_cast<int>(cores.size());
+    if (replicaNum <= 0) {
+        replicaNum = 1;
+    }
+    if (replicaNum > static_cast<int>(cores.size())) {
+        slog::warn << replicaNum << " replicas on " << cores.size() << " physical cores, cores are shared"
+                   << slog::endl;
+    }
+
+    /** 副本单线程推断,线程预算由绑定的核决定;共享插件已开启线程绑定时在网络级关闭,保留副本的绑核 **/
+    std::map<std::string, std::string> loadConfig;
+    loadConfig[PluginConfigParams::KEY_SINGLE_THREAD] = PluginConfigParams::YES;
+    loadConfig[PluginConfigParams::KEY_CPU_BIND_THREAD] = PluginConfigParams::NO;
+    if (config.latencyParts > 1 || !adaptiveViews.empty()) {
+        loadConfig[PluginConfigParams::KEY_DYN_BATCH_ENABLED] = PluginConfigParams::YES;
+        loadConfig[PluginConfigParams::KEY_DYN_BATCH_LIMIT] = std::to_string(config.viewNum());
+    }
+    CNNNetwork network = reader.getNetwork();
+    NetReplica::NetworkLoader loader = [this, &network, &loadConfig] {
+        return ModelRegistry::instance().load_network(config, network, loadConfig);
+    };
+    for (int i = 0; i < replicaNum; ++i) {
+        ReplicaSlot slot;
+        std::vector<int> cpus;
+        if (!cores.empty()) {
+            cpus = cores[i % cores.size()].cpus;
+            slot.node = cores[i % cores.size()].node;
+        }
+        /** 网络在副本的绑核线程中加载,权重和请求blob首次访问发生在副本所在节点 **/
+        slot.replica.reset(new NetReplica(loader, cpus));
+        /** NUMA模式下每个节点一份均值表,同样在副本线程中生成 **/
+        if (config.numa && meanTable) {
+            int node = slot.node;
+            std::shared_ptr<const MeanTable> nodeMean;
+            slot.replica->submit([this, node, &nodeMean](InferRequest &) {
+                nodeMean = MeanCache::instance().get(config.pImageInfo->meanFile, meanTable->width,
+                                                     meanTable->height, config.pImageInfo->channel,
+                                                     meanTable->interleaved, config.pImageInfo->scale, node);
+            }).get();
+            slot.meanTable = nodeMean;
+        }
+        replicas.push_back(std::move(slot));
+    }
+    slog::info << "created " << replicaNum << " pinned replicas for " << config.modelName << slog::endl;
     return 1;
 }
 
+/**
+ * 选择未完成任务最少的副本,从轮转位置开始查找以打散负载相同的副本
+ */
+Openvino_Net::ReplicaSlot &Openvino_Net::least_loaded_replica() {
+    /** 调用线程所在节点,非NUMA模式或无法确定时为-1 **/
+    int node = -1;
+    if (!cpuNodes.empty()) {
+        int cpu = sched_getcpu();
+        if (cpu >= 0 && cpu < static_cast<int>(cpuNodes.size())) {
+            node = cpuNodes[cpu];
+        }
+    }
+    size_t start = nextReplica++ % replicas.size();
+    size_t best = replicas.size();
+    for (size_t i = 0; i < replicas.size(); ++i) {
+        size_t index = (start + i) % replicas.size();
+        if (node >= 0 && replicas[index].node != node) {
+            continue;
+        }
+        if (best == replicas.size() || replicas[index].replica->load() < replicas[best].replica->load()) {
+            best = index;
+        }
+    }
+    /** 本节点没有副本时在全部副本中选择 **/
+    if (best == replicas.size()) {
+        best = start;
+        for (size_t i = 1; i < replicas.size(); ++i) {
+            size_t index = (start + i) % replicas.size();
+            if (replicas[index].replica->load() < replicas[best].replica->load()) {
+                best = index;
+            }
+        }
+    }
+    return replicas[best];
+}
+
 /**
  * 推断
  */
 void Openvino_Net::inference(Output &output, unsigned char *pImageHead, int imageW, int imageH) {
-    /** 创建请求 **/
-    InferRequest inferRequest = executableNetwork.CreateInferRequest();
+    inference(output, pImageHead, imageW, imageH, config.inferenceMode);
+}
+
+/**
+ * 按指定模式推断
+ */
+void Openvino_Net::inference(Output &output, unsigned char *pImageHead, int imageW, int imageH, InferenceMode mode) {
+    /** 分辨率分桶 **/
+    if (Openvino_Net *bucket = route_bucket(imageW, imageH)) {
+        bucket->inference(output, pImageHead, imageW, imageH, mode);
+        return;
+    }
+    /** 延迟模式:视图拆分到多个请求(或副本)并发推断;插件预处理本身即每个视图一个请求 **/
+    if (mode == InferenceMode::LATENCY && config.latencyParts > 1 && !config.pluginPreprocess &&
+        config.viewNum() > 1) {
+        inference_latency(output, pImageHead, imageW, imageH);
+        return;
+    }
+    /** 自适应TTA **/
+    if (!adaptiveViews.empty()) {
+        inference_adaptive(output, pImageHead, imageW, imageH);
+        return;
+    }
+    /** 吞吐模式:在最空闲副本的绑核线程中推断 **/
+    if (!replicas.empty()) {
+        ReplicaSlot &slot = least_loaded_replica();
+        const MeanTable *pMeanTable = slot.meanTable.get();
+        slot.replica->submit([this, &output, pImageHead, imageW, imageH, pMeanTable](InferRequest &request) {
+            fill_data(request, config, pImageHead, imageW, imageH, 0, pMeanTable);
+            request.Infer();
+            collectOutPut(request, config, output);
+        }).get();
+        return;
+    }
+    /** 插件预处理 **/
+    if (config.pluginPreprocess) {
+        inference_plugin_preprocess(output, pImageHead, imageW, imageH);
+        return;
+    }
+    /** 合并批处理 **/
+    if (config.batchImages > 1) {
+        inference_batched(output, pImageHead, imageW, imageH);
+        return;
+    }
+    /** 上一次结果仍引用着请求时先归还,避免请求池耗尽 **/
+    if (config.borrowOutput) {
+        output.reset();
+    }
+    /** 从请求池借出请求,最后一个引用释放时自动归还(结果引用输出blob时由结果持有) **/
+    std::shared_ptr<InferRequest> request = requestPool.lease();
     /** 填充请求数据 **/
-    fill_data(inferRequest, config, pImageHead, imageW, imageH);
+    fill_data(*request, config, pImageHead, imageW, imageH);
     /** 进行推断 **/
-    inferRequest.Infer();
+    request->Infer();
     /** 收集输出层结果 **/
-    collectOutPut(inferRequest, config, output);
+    collectOutPut(*request, config, output, 0, 0, config.borrowOutput ? request : nullptr);
+}
+
+/**
+ * 预热
+ * 先让每个池化请求(或每个副本)各推断一次,完成各自的原语创建和内存首次访问;
+ * 再按窗口连续推断,直到相邻两个窗口的p99延迟变化不超过容差(或达到最大推断次数)
+ */
+void Openvino_Net::warm_up() {
+    ready = false;
+    if (config.warmUpRounds <= 0) {
+        ready = true;
+        return;
+    }
+    /** 合成图片与网络输入同尺寸,像素取中间灰度 **/
+    int imageW = config.pImageInfo->height;
+    int imageH = config.pImageInfo->width;
+    std::vector<unsigned char> image(static_cast<size_t>(imageW * imageH * 3), 128);
+
+    warm_up_requests(image.data(), imageW, imageH);
+
+    Output output;
+    std::vector<double> latencies;
+    double lastP99 = 0, p99 = 0;
+    int rounds = 0;
+    bool stable = false;
+    while (!stable && rounds < config.warmUpMaxRounds) {
+        latencies.clear();
+        for (int i = 0; i < config.warmUpRounds && rounds < config.warmUpMaxRounds; ++i, ++rounds) {
+            auto begin = std::chrono::steady_clock::now();
+            inference(output, image.data(), imageW, imageH);
+            latencies.push_back(
+                    std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count());
+        }
+        std::sort(latencies.begin(), latencies.end());
+        p99 = latencies[std::min(latencies.size() - 1, static_cast<size_t>(latencies.size() * 0.99))];
+        stable = lastP99 > 0 && std::fabs(p99 - lastP99) <= config.warmUpTolerance * lastP99;
+        lastP99 = p99;
+    }
+    if (stable) {
+        slog::info << config.modelName << " warmed up in " << rounds << " rounds, p99 " << p99 << " ms" << slog::endl;
+    } else {
+        slog::warn << config.modelName << " p99 not stable after " << rounds << " warm-up rounds, last p99 " << p99
+                   << " ms" << slog::endl;
+    }
+    ready = true;
+}
+
+/**
+ * 每个池化请求(或每个副本)用合成图片各推断一次
+ */
+void Openvino_Net::warm_up_requests(unsigned char *pImageHead, int imageW, int imageH) {
+    /** 副本在各自的绑核线程中并发推断 **/
+    if (!replicas.empty()) {
+        std::vector<std::future<void>> done;
+        for (auto &slot : replicas) {
+            const MeanTable *pMeanTable = slot.meanTable.get();
+            done.push_back(slot.replica->submit([this, pImageHead, imageW, imageH, pMeanTable](InferRequest &request) {
+                fill_data(request, config, pImageHead, imageW, imageH, 0, pMeanTable);
+                request.Infer();
+            }));
+        }
+        for (auto &item : done) {
+            item.get();
+        }
+        return;
+    }
+
+    /** 借出全部请求并发推断 **/
+    std::vector<InferRequest::Ptr> requests;
+    requestPool.acquire(requestPool.size(), requests);
+    cv::Mat image(imageH, imageW, CV_8UC3, pImageHead);
+    try {
+        for (auto &request : requests) {
+            if (config.pluginPreprocess) {
+                request->SetBlob(inputNames[0], wrap_image(image));
+            } else {
+                fill_data(*request, config, pImageHead, imageW, imageH);
+            }
+            request->StartAsync();
+        }
+        for (auto &request : requests) {
+            request->Wait(IInferRequest::WaitMode::RESULT_READY);
+        }
+    } catch (...) {
+        for (auto &request : requests) {
+            request->Wait(IInferRequest::WaitMode::RESULT_READY);
+        }
+        requestPool.release(requests);
+        throw;
+    }
+    requestPool.release(requests);
+}
+
+/**
+ * 插件预处理推断
+ * 原始u8图片不做缩放和浮点展开,每个裁剪窗口映射回原图坐标后以ROI blob零拷贝交给插件,
+ * 翻转视图在u8上翻转后交给插件;每个视图一个请求,并发推断后按视图顺序拼接结果
+ */
+void Openvino_Net::inference_plugin_preprocess(Output &output, unsigned char *pImageHead, int imageW, int imageH) {
+    int width = config.pImageInfo->height;
+    int height = config.pImageInfo->width;
+    int cropNum = config.pImageInfo->cropNum;
+    int cropViews = cropNum > 0 ? cropNum : 1;
+    int viewW = cropNum > 0 ? config.pImageInfo->corpSize_W : width;
+    int viewH = cropNum > 0 ? config.pImageInfo->cropSize_H : height;
+    int viewNum = config.viewNum();
+
+    /** 网络需要RGB时做一次u8通道转换,转换缓冲区按线程复用 **/
+    cv::Mat image(imageH, imageW, CV_8UC3, pImageHead);
+    static thread_local cv::Mat rgb;
+    static thread_local std::vector<cv::Mat> flipped;
+    cv::Mat source = image;
+    if (config.swapRB) {
+        cv::cvtColor(image, rgb, cv::COLOR_BGR2RGB);
+        source = rgb;
+    }
+    Blob::Ptr frameBlob = wrap_image(source);
+    flipped.resize(static_cast<size_t>(cropViews));
+
+    std::vector<InferRequest::Ptr> requests;
+    requestPool.acquire(viewNum, requests);
+    try {
+        /** 裁剪窗口从缩放后坐标映射回原图坐标 **/
+        float fx = static_cast<float>(imageW) / width;
+        float fy = static_cast<float>(imageH) / height;
+        int v = 0;
+        for (int mirror = 0; mirror < (config.pImageInfo->flip ? 2 : 1); ++mirror) {
+            for (int i = 0; i < cropViews; ++i, ++v) {
+                int x = cropNum > 0 ? config.pImageInfo->corpPoint[i][0] : 0;
+                int y = cropNum > 0 ? config.pImageInfo->corpPoint[i][1] : 0;
+                ROI roi;
+                roi.id = 0;
+                roi.posX = static_cast<size_t>(x * fx);
+                roi.posY = static_cast<size_t>(y * fy);
+                roi.sizeX = std::min(static_cast<size_t>(viewW * fx + 0.5f), imageW - roi.posX);
+                roi.sizeY = std::min(static_cast<size_t>(viewH * fy + 0.5f), imageH - roi.posY);
+                Blob::Ptr viewBlob;
+                if (!mirror) {
+                    viewBlob = make_shared_blob(frameBlob, roi);
+                } else {
+                    cv::Rect rect((int) roi.posX, (int) roi.posY, (int) roi.sizeX, (int) roi.sizeY);
+                    cv::flip(source(rect), flipped[i], 1);
+                    viewBlob = wrap_image(flipped[i]);
+                }
+                requests[v]->SetBlob(inputNames[0], viewBlob);
+                requests[v]->StartAsync();
+            }
+        }
+        for (auto &request : requests) {
+            request->Wait(IInferRequest::WaitMode::RESULT_READY);
+        }
+        collectViews(requests, output);
+    } catch (...) {
+        for (auto &request : requests) {
+            request->Wait(IInferRequest::WaitMode::RESULT_READY);
+        }
+        requestPool.release(requests);
+        throw;
+    }
+    requestPool.release(requests);
+}
+
+/**
+ * 按视图顺序拼接多个请求(每个请求batch为1)的结果
+ */
+void Openvino_Net::collectViews(std::vector<InferRequest::Ptr> &requests, Output &output) {
+    prepare_views(output);
+    for (size_t v = 0; v < requests.size(); ++v) {
+        copy_views(*requests[v], output, static_cast<int>(v), 1);
+    }
+    finish_views(output);
+}
+
+/**
+ * 按视图数分配结果缓冲区,之后各请求的视图结果可以并发拷贝到不同位置
+ */
+void Openvino_Net::prepare_views(Output &output) {
+    if (output.names.empty()) {
+        output.names = defaultOutputs;
+    }
+    output.reset();
+    size_t viewNum = static_cast<size_t>(config.viewNum());
+    for (const auto &outputName : output.names) {
+        OutputTensor &tensor = output.tensors[outputName];
+        tensor.shape = outputDims.at(outputName);
+        size_t rowDim = 1;
+        for (size_t i = 1; i < tensor.shape.size(); ++i) {
+            rowDim *= tensor.shape[i];
+        }
+        tensor.shape[0] = viewNum;
+        tensor.allocate(rowDim * viewNum);
+    }
+}
+
+/**
+ * 拷贝视图结果
+ */
+void Openvino_Net::copy_views(InferRequest &inferRequest, Output &output, int firstView, int count) {
+    for (const auto &outputName : output.names) {
+        OutputTensor &tensor = output.tensors.at(outputName);
+        size_t rowDim = static_cast<size_t>(tensor.getTotalDim()) / tensor.shape[0];
+        Blob::Ptr outputBlob = inferRequest.GetBlob(outputName);
+        LockedMemory<const void> memLocker = outputBlob->cbuffer();
+        auto data = memLocker.as<const PrecisionTrait<Precision::FP32>::value_type *>();
+        std::copy(data, data + rowDim * count, tensor.data + rowDim * firstView);
+    }
+}
+
+/**
+ * 归约和编码
+ */
+void Openvino_Net::finish_views(Output &output) {
+    for (const auto &outputName : output.names) {
+        OutputTensor &tensor = output.tensors.at(outputName);
+        size_t views = tensor.shape[0];
+        if (config.reduction != ViewReduction::NONE && views > 1) {
+            size_t rowDim = static_cast<size_t>(tensor.getTotalDim()) / views;
+            tensor.shape[0] = 1;
+            reduce_views(tensor.data, views, rowDim, config.reduction, tensor.data);
+        }
+        encode_collected(tensor, config.outputEncoding);
+    }
+}
+
+/**
+ * 延迟模式推断
+ * 图片只缩放一次,视图按顺序均分为若干部分,每部分以动态batch在一个池化请求(或一个副本)中并发推断,
+ * 各部分结果直接拷贝到对应视图的位置;请求归还前恢复完整batch
+ */
+void Openvino_Net::inference_latency(Output &output, unsigned char *pImageHead, int imageW, int imageH) {
+    int width = config.pImageInfo->height;
+    int height = config.pImageInfo->width;
+    int viewNum = config.viewNum();
+    int fullBatch = viewNum * config.batchImages;
+    pImageHead = resize_input(pImageHead, imageW, imageH);
+    std::vector<int> views(static_cast<size_t>(viewNum));
+    std::iota(views.begin(), views.end(), 0);
+
+    /** 上一次结果仍引用着请求时先归还,避免请求池耗尽 **/
+    output.reset();
+    int workers = replicas.empty() ? requestPool.size() : static_cast<int>(replicas.size());
+    int parts = std::max(1, std::min(std::min(config.latencyParts, viewNum), workers));
+    std::vector<int> firstViews(static_cast<size_t>(parts + 1), 0);
+    for (int p = 0; p < parts; ++p) {
+        firstViews[p + 1] = firstViews[p] + viewNum / parts + (p < viewNum % parts ? 1 : 0);
+    }
+    prepare_views(output);
+
+    if (!replicas.empty()) {
+        /** 选择未完成任务最少的parts个副本,从轮转位置开始以打散负载相同的副本 **/
+        std::vector<size_t> order(replicas.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::rotate(order.begin(), order.begin() + nextReplica++ % replicas.size(), order.end());
+        std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+            return replicas[a].replica->load() < replicas[b].replica->load();
+        });
+        std::vector<std::future<void>> done;
+        for (int p = 0; p < parts; ++p) {
+            ReplicaSlot &slot = replicas[order[p]];
+            const MeanTable *pMeanTable = slot.meanTable.get();
+            int first = firstViews[p];
+            int count = firstViews[p + 1] - first;
+            done.push_back(slot.replica->submit(
+                    [this, &output, pImageHead, width, height, pMeanTable, &views, first, count, fullBatch](
+                            InferRequest &request) {
+                        request.SetBatch(count);
+                        try {
+                            fill_data(request, config, pImageHead, width, height, 0, pMeanTable, &views[first],
+                                      count);
+                            request.Infer();
+                            copy_views(request, output, first, count);
+                        } catch (...) {
+                            request.SetBatch(fullBatch);
+                            throw;
+                        }
+                        request.SetBatch(fullBatch);
+                    }));
+        }
+        /** 全部部分完成后才能返回,任务引用着调用方的图片和结果 **/
+        std::exception_ptr error;
+        for (auto &item : done) {
+            try {
+                item.get();
+            } catch (...) {
+                error = std::current_exception();
+            }
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+        finish_views(output);
+        return;
+    }
+
+    std::vector<InferRequest::Ptr> requests;
+    requestPool.acquire(parts, requests);
+    try {
+        for (int p = 0; p < parts; ++p) {
+            int count = firstViews[p + 1] - firstViews[p];
+            requests[p]->SetBatch(count);
+            fill_data(*requests[p], config, pImageHead, width, height, 0, nullptr, &views[firstViews[p]], count);
+            requests[p]->StartAsync();
+        }
+        for (int p = 0; p < parts; ++p) {
+            requests[p]->Wait(IInferRequest::WaitMode::RESULT_READY);
+            copy_views(*requests[p], output, firstViews[p], firstViews[p + 1] - firstViews[p]);
+        }
+    } catch (...) {
+        for (auto &request : requests) {
+            request->Wait(IInferRequest::WaitMode::RESULT_READY);
+            request->SetBatch(fullBatch);
+        }
+        requestPool.release(requests);
+        throw;
+    }
+    for (auto &request : requests) {
+        request->SetBatch(fullBatch);
+    }
+    requestPool.release(requests);
+    finish_views(output);
+}
+
+/**
+ * 缩放图片到网络输入大小
+ */
+unsigned char *Openvino_Net::resize_input(unsigned char *pImageHead, int imageW, int imageH) {
+    int width = config.pImageInfo->height;
+    int height = config.pImageInfo->width;
+    if (imageW == width && imageH == height) {
+        return pImageHead;
+    }
+    static thread_local cv::Mat resized;
+    cv::Mat image(imageH, imageW, CV_8UC3, pImageHead);
+    cv::resize(image, resized, cv::Size(width, height));
+    return resized.data;
+}
+
+/**
+ * 选择自适应TTA的视图顺序
+ * 先行视图为中心最接近缩放后图片中心的裁剪视图,以及它的翻转视图(无翻转时为距中心次近的裁剪视图)
+ */
+void Openvino_Net::init_adaptive_views() {
+    adaptiveViews.clear();
+    if (config.earlyExitCosine <= 0) {
+        return;
+    }
+    int viewNum = config.viewNum();
+    if (config.reduction == ViewReduction::NONE || config.pluginPreprocess || config.batchImages > 1 ||
+        viewNum <= 2) {
+        slog::warn << "earlyExitCosine needs reduction, more than 2 views, no batchImages and no pluginPreprocess"
+                   << slog::endl;
+        config.earlyExitCosine = 0;
+        return;
+    }
+    int cropNum = config.pImageInfo->cropNum;
+    int cropViews = cropNum > 0 ? cropNum : 1;
+    float centerX = config.pImageInfo->height / 2.0f;
+    float centerY = config.pImageInfo->width / 2.0f;
+    std::vector<int> crops(static_cast<size_t>(cropViews));
+    std::iota(crops.begin(), crops.end(), 0);
+    if (cropNum > 0) {
+        auto distance = [this, centerX, centerY](int i) {
+            float dx = config.pImageInfo->corpPoint[i][0] + config.pImageInfo->corpSize_W / 2.0f - centerX;
+            float dy = config.pImageInfo->corpPoint[i][1] + config.pImageInfo->cropSize_H / 2.0f - centerY;
+            return dx * dx + dy * dy;
+        };
+        std::stable_sort(crops.begin(), crops.end(), [&distance](int a, int b) {
+            return distance(a) < distance(b);
+        });
+    }
+    adaptiveViews.push_back(crops[0]);
+    adaptiveViews.push_back(config.pImageInfo->flip ? crops[0] + cropViews : crops[1]);
+    for (int view = 0; view < viewNum; ++view) {
+        if (view != adaptiveViews[0] && view != adaptiveViews[1]) {
+            adaptiveViews.push_back(view);
+        }
+    }
+}
+
+/**
+ * 自适应TTA推断
+ * 结果按推断顺序(先行视图在前)写入,开启reduction时视图顺序不影响结果
+ */
+void Openvino_Net::inference_adaptive(Output &output, unsigned char *pImageHead, int imageW, int imageH) {
+    pImageHead = resize_input(pImageHead, imageW, imageH);
+    /** 上一次结果仍引用着请求时先归还,避免请求池耗尽 **/
+    output.reset();
+    prepare_views(output);
+    if (!replicas.empty()) {
+        ReplicaSlot &slot = least_loaded_replica();
+        const MeanTable *pMeanTable = slot.meanTable.get();
+        slot.replica->submit([this, &output, pImageHead, pMeanTable](InferRequest &request) {
+            infer_adaptive(request, output, pImageHead, pMeanTable);
+        }).get();
+    } else {
+        std::shared_ptr<InferRequest> request = requestPool.lease();
+        infer_adaptive(*request, output, pImageHead, nullptr);
+    }
+    finish_views(output);
+}
+
+/**
+ * 先行视图推断及按需补充推断,请求归还前恢复完整batch
+ */
+void Openvino_Net::infer_adaptive(InferRequest &inferRequest, Output &output, unsigned char *pImageHead,
+                                  const MeanTable *pMeanTable) {
+    int width = config.pImageInfo->height;
+    int height = config.pImageInfo->width;
+    int viewNum = config.viewNum();
+    const int probeNum = 2;
+    try {
+        inferRequest.SetBatch(probeNum);
+        fill_data(inferRequest, config, pImageHead, width, height, 0, pMeanTable, adaptiveViews.data(), probeNum);
+        inferRequest.Infer();
+        copy_views(inferRequest, output, 0, probeNum);
+
+        OutputTensor &tensor = output.first();
+        size_t rowDim = static_cast<size_t>(tensor.getTotalDim()) / tensor.shape[0];
+        if (cosine_similarity(tensor.data, tensor.data + rowDim, rowDim) >= config.earlyExitCosine) {
+            /** 先行视图一致,只归约先行视图 **/
+            for (auto &item : output.tensors) {
+                item.second.shape[0] = probeNum;
+            }
+        } else {
+            int restNum = viewNum - probeNum;
+            inferRequest.SetBatch(restNum);
+            fill_data(inferRequest, config, pImageHead, width, height, 0, pMeanTable, adaptiveViews.data() + probeNum,
+                      restNum);
+            inferRequest.Infer();
+            copy_views(inferRequest, output, probeNum, restNum);
+        }
+    } catch (...) {
+        inferRequest.SetBatch(viewNum);
+        throw;
+    }
+    inferRequest.SetBatch(viewNum);
+}
+
+/**
+ * 预处理签名
+ * 包含缩放大小,裁剪,翻转,输入布局;归一化在主机端时还包含均值文件和归一化系数
+ */
+std::string Openvino_Net::preprocess_signature() const {
+    if (config.pluginPreprocess || config.batchImages > 1 || !adaptiveViews.empty() || !bucketNets.empty() ||
+        inputNames.size() != 1) {
+        return "";
+    }
+    const ImageInfo &info = *config.pImageInfo;
+    std::ostringstream signature;
+    signature << info.width << "_" << info.height << "|" << info.flip << "|" << info.corpSize_W << "_"
+              << info.cropSize_H << "_" << info.cropNum;
+    for (int i = 0; i < info.cropNum; ++i) {
+        signature << "|" << info.corpPoint[i][0] << "_" << info.corpPoint[i][1];
+    }
+    signature << "|" << config.swapRB;
+    if (config.foldMean) {
+        signature << "|u8";
+    } else {
+        signature << "|" << (config.inputLayout == Layout::NCHW ? "planar" : "interleaved") << "|"
+                  << (meanTable ? info.meanFile : "") << "|" << info.scale;
+    }
+    return signature.str();
+}
+
+/**
+ * 预处理结果字节数
+ */
+size_t Openvino_Net::preprocess_bytes() const {
+    const ImageInfo &info = *config.pImageInfo;
+    size_t viewSize = info.cropNum > 0 ? (size_t) info.corpSize_W * info.cropSize_H : (size_t) info.width * info.height;
+    size_t elementSize = config.foldMean ? sizeof(uint8_t) : sizeof(float);
+    return elementSize * viewSize * 3 * config.viewNum();
+}
+
+/**
+ * 预处理一张图片
+ */
+void Openvino_Net::preprocess(unsigned char *pImageHead, int imageW, int imageH, void *pDst) {
+    ex_pic(pDst, config, pImageHead, imageW, imageH, meanTable.get());
+}
+
+/**
+ * 用共享的预处理结果启动推断
+ * 预处理结果拷贝进输入blob;副本模式下在副本线程中推断,否则借出请求异步推断
+ */
+std::function<void()> Openvino_Net::start_preprocessed(Output &output, const void *pInput) {
+    size_t inputBytes = preprocess_bytes();
+    if (!replicas.empty()) {
+        ReplicaSlot &slot = least_loaded_replica();
+        auto done = std::make_shared<std::future<void>>(
+                slot.replica->submit([this, &output, pInput, inputBytes](InferRequest &request) {
+                    Blob::Ptr input = request.GetBlob(inputNames[0]);
+                    memcpy(input->buffer().as<uint8_t *>(), pInput, inputBytes);
+                    request.Infer();
+                    collectOutPut(request, config, output);
+                }));
+        return [done] {
+            done->get();
+        };
+    }
+    /** 上一次结果仍引用着请求时先归还,避免请求池耗尽 **/
+    if (config.borrowOutput) {
+        output.reset();
+    }
+    std::shared_ptr<InferRequest> request = requestPool.lease();
+    Blob::Ptr input = request->GetBlob(inputNames[0]);
+    memcpy(input->buffer().as<uint8_t *>(), pInput, inputBytes);
+    request->StartAsync();
+    return [this, request, &output] {
+        request->Wait(IInferRequest::WaitMode::RESULT_READY);
+        collectOutPut(*request, config, output, 0, 0, config.borrowOutput ? request : nullptr);
+    };
+}
+
+/**
+ * 合并批处理推断
+ * 并发调用者在同一个请求中各自领取一个槽位(一张图片的全部视图)并填充数据,
+ * 第一个领取者作为组长,在槽位领满或等待超时后以实际图片数推断,再把结果按槽位拆分给各调用者
+ */
+void Openvino_Net::inference_batched(Output &output, unsigned char *pImageHead, int imageW, int imageH) {
+    std::shared_ptr<BatchGroup> group;
+    int slot;
+
+    /** 领取槽位,没有未封口的批次时借出新请求开启一个批次 **/
+    std::unique_lock<std::mutex> lock(batchMutex);
+    while (!openBatch) {
+        /** 借出请求时不能持有锁,否则会阻塞正在完成的批次 **/
+        lock.unlock();
+        InferRequest::Ptr request = requestPool.acquire();
+        lock.lock();
+        if (openBatch) {
+            lock.unlock();
+            requestPool.release(request);
+            lock.lock();
+            continue;
+        }
+        openBatch = std::make_shared<BatchGroup>();
+        openBatch->request = request;
+        openBatch->outputs.resize(static_cast<size_t>(config.batchImages));
+        openBatch->deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(config.batchWaitUs);
+    }
+    group = openBatch;
+    slot = group->claimed++;
+    group->outputs[slot] = &output;
+    if (group->claimed == config.batchImages) {
+        group->sealed = true;
+        openBatch.reset();
+    }
+    lock.unlock();
+
+    /** 填充自己的槽位 **/
+    std::exception_ptr fillError;
+    try {
+        fill_data(*group->request, config, pImageHead, imageW, imageH, slot * config.viewNum());
+    } catch (...) {
+        fillError = std::current_exception();
+    }
+
+    lock.lock();
+    group->written++;
+    if (fillError && !group->error) {
+        group->error = fillError;
+    }
+    if (slot != 0) {
+        /** 组员等待组长完成推断 **/
+        batchCond.notify_all();
+        batchCond.wait(lock, [&group] { return group->finished; });
+        if (group->error) {
+            std::rethrow_exception(group->error);
+        }
+        return;
+    }
+
+    /** 组长等待槽位领满或超时,然后封口并等待所有组员写完 **/
+    batchCond.wait_until(lock, group->deadline, [&group] { return group->sealed; });
+    if (!group->sealed) {
+        group->sealed = true;
+        if (openBatch == group) {
+            openBatch.reset();
+        }
+    }
+    batchCond.wait(lock, [&group] { return group->written == group->claimed; });
+    lock.unlock();
+
+    /** 以实际图片数推断并拆分结果 **/
+    int viewNum = config.viewNum();
+    if (!group->error) {
+        try {
+            group->request->SetBatch(group->claimed * viewNum);
+            group->request->Infer();
+            for (int i = 0; i < group->claimed; ++i) {
+                collectOutPut(*group->request, config, *group->outputs[i], i * viewNum, viewNum);
+            }
+        } catch (...) {
+            group->error = std::current_exception();
+        }
+    }
+    /** 请求归还前恢复完整batch **/
+    try {
+        group->request->SetBatch(viewNum * config.batchImages);
+    } catch (...) {
+        if (!group->error) {
+            group->error = std::current_exception();
+        }
+    }
+    requestPool.release(group->request);
+
+    lock.lock();
+    group->finished = true;
+    batchCond.notify_all();
+    if (group->error) {
+        std::rethrow_exception(group->error);
+    }
+}
+
+/**
+ * 异步推断
+ */
+void Openvino_Net::inference_async(unsigned char *pImageHead, int imageW, int imageH,
+                                   const InferenceCallback &callback) {
+    if (Openvino_Net *bucket = route_bucket(imageW, imageH)) {
+        bucket->inference_async(pImageHead, imageW, imageH, callback);
+        return;
+    }
+    if (config.pluginPreprocess) {
+        throw std::logic_error("inference_async does not support pluginPreprocess");
+    }
+    /** 吞吐模式:拷贝图片后交给最空闲的副本,在副本线程中推断并回调 **/
+    if (!replicas.empty()) {
+        auto image = std::make_shared<std::vector<unsigned char>>(pImageHead, pImageHead + imageW * imageH * 3);
+        ReplicaSlot &slot = least_loaded_replica();
+        const MeanTable *pMeanTable = slot.meanTable.get();
+        slot.replica->submit([this, image, imageW, imageH, callback, pMeanTable](InferRequest &request) {
+            Output output;
+            StatusCode status = StatusCode::OK;
+            try {
+                fill_data(request, config, image->data(), imageW, imageH, 0, pMeanTable);
+                request.Infer();
+                collectOutPut(request, config, output);
+            } catch (const std::exception &error) {
+                slog::err << "replica inference failed: " << error.what() << slog::endl;
+                status = StatusCode::GENERAL_ERROR;
+            }
+            try {
+                callback(output, status);
+            } catch (const std::exception &error) {
+                slog::err << "async inference callback failed: " << error.what() << slog::endl;
+            }
+        });
+        return;
+    }
+    /** 借出请求,在完成回调中归还 **/
+    InferRequest::Ptr request = requestPool.acquire();
+    AsyncJob &job = async_job(request.get());
+    try {
+        /** 在调用线程中填充请求数据 **/
+        fill_data(*request, config, pImageHead, imageW, imageH);
+        if (config.batchImages > 1) {
+            request->SetBatch(config.viewNum());
+        }
+        job.output = std::make_shared<Output>();
+        job.callback = callback;
+        /** 启动推断,立即返回 **/
+        request->StartAsync();
+    } catch (...) {
+        job.output.reset();
+        job.callback = nullptr;
+        if (config.batchImages > 1) {
+            try {
+                request->SetBatch(config.viewNum() * config.batchImages);
+            } catch (const std::exception &error) {
+                slog::warn << "restore batch failed: " << error.what() << slog::endl;
+            }
+        }
+        requestPool.release(request);
+        throw;
+    }
+}
+
+/**
+ * 异步推断,通过future获取结果
+ */
+std::future<std::shared_ptr<Output>>
+Openvino_Net::inference_async(unsigned char *pImageHead, int imageW, int imageH) {
+    auto promise = std::make_shared<std::promise<std::shared_ptr<Output>>>();
+    std::future<std::shared_ptr<Output>> future = promise->get_future();
+    inference_async(pImageHead, imageW, imageH, [promise](Output &output, StatusCode status) {
+        if (status != StatusCode::OK) {
+            promise->set_exception(std::make_exception_ptr(
+                    std::runtime_error("async inference failed, status " + std::to_string(status))));
+            return;
+        }
+        /** 转移结果所有权 **/
+        auto pOutput = std::make_shared<Output>(std::move(output));
+        promise->set_value(pOutput);
+    });
+    return future;
+}
+
+/**
+ * 查找请求对应的异步状态,映射建立后不再增删,返回的引用在网络存在期间有效
+ */
+Openvino_Net::AsyncJob &Openvino_Net::async_job(InferRequest *pRequest) {
+    std::lock_guard<std::mutex> lock(asyncMutex);
+    auto iter = asyncJobs.find(pRequest);
+    if (iter == asyncJobs.end()) {
+        throw std::logic_error("request does not belong to the pool");
+    }
+    return iter->second;
+}
+
+/**
+ * 异步请求完成处理
+ */
+void Openvino_Net::on_async_complete(InferRequest *pRequest, StatusCode status) {
+    AsyncJob &job = async_job(pRequest);
+    /** 同步推断时没有待处理任务 **/
+    if (!job.callback) {
+        return;
+    }
+    InferenceCallback callback;
+    callback.swap(job.callback);
+    std::shared_ptr<Output> output;
+    output.swap(job.output);
+    /** 请求在最后一个引用释放时归还;结果引用输出blob时由结果持有 **/
+    InferRequest::Ptr request = job.request;
+    std::shared_ptr<void> owner(request.get(), [this, request](void *) {
+        /** 合并批处理的请求归还前恢复完整batch **/
+        if (config.batchImages > 1) {
+            try {
+                request->SetBatch(config.viewNum() * config.batchImages);
+            } catch (const std::exception &error) {
+                slog::warn << "restore batch failed: " << error.what() << slog::endl;
+            }
+        }
+        requestPool.release(request);
+    });
+    try {
+        if (status == StatusCode::OK) {
+            collectOutPut(*request, config, *output, 0, config.batchImages > 1 ? config.viewNum() : 0,
+                          config.borrowOutput ? owner : nullptr);
+        }
+    } catch (const std::exception &error) {
+        slog::err << "collect async output failed: " << error.what() << slog::endl;
+        status = StatusCode::GENERAL_ERROR;
+    }
+    try {
+        callback(*output, status);
+    } catch (const std::exception &error) {
+        slog::err << "async inference callback failed: " << error.what() << slog::endl;
+    }
+    /** 回调结束后再归还请求 **/
+    owner.reset();
+    output.reset();
 }
 
 // --------------------------------------------------测试函数区-------------------------------------------------//
@@ -23,12 +23,50 @@
 #include <pthread.h>
 #include <sched.h>
 #include <ctype.h>
+#include <map>
+#include <future>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <stdexcept>
+
+#include "mogu_infer_pool.h"
+#include "mogu_mean_cache.h"
+#include "mogu_buffer_pool.h"
+#include "mogu_encode.h"
+#include "mogu_reduce.h"
+#include "mogu_replica.h"
+#include "mogu_weights_cache.h"
 
 using namespace InferenceEngine;
 enum ChanelType : u_int8_t {
     BGR,
     RGB,
 };
+/**
+ * 推断结果的导出编码
+ */
+enum class OutputEncoding : u_int8_t {
+    FP32,
+    FP16,
+    /**
+     * 对称int8量化,每个向量一个scale
+     */
+    INT8,
+};
+/**
+ * 推断模式
+ */
+enum class InferenceMode : u_int8_t {
+    /**
+     * 一张图片的全部视图在一个请求中批量推断
+     */
+    THROUGHPUT,
+    /**
+     * 一张图片的视图拆分到多个请求(或副本)并发推断,降低单张图片的延迟
+     */
+    LATENCY,
+};
 /**
  * 输入层图片信息(必须)
  */
@@ -61,7 +99,7 @@ struct ImageInfo {
 
 struct Config {
     Config() {
-        pImageInfo = (ImageInfo *)malloc(sizeof(ImageInfo));
+        pImageInfo = new ImageInfo();
     }
     // ----------------------------------------必须参数--------------------------------//
     /**
@@ -96,6 +134,129 @@ struct Config {
      * 输出层数据精度
      */
     InferenceEngine::Precision outputPrecision = InferenceEngine::Precision::FP32;
+    /**
+     * 请求池大小,即同时进行推断的最大请求数
+     */
+    int requestNum = 4;
+    /**
+     * 合并批处理的最大图片数,大于1时开启:并发调用者的图片合并进同一个请求推断
+     */
+    int batchImages = 1;
+    /**
+     * 合并批处理时,批次的最长等待时间(微秒)
+     */
+    int batchWaitUs = 2000;
+    /**
+     * 插件预处理:输入原始u8图片,裁剪用ROI blob零拷贝,由插件完成缩放和按通道减均值/归一化
+     */
+    int pluginPreprocess = 0;
+    /**
+     * 网络输入是否为RGB(输入图片为BGR,需要交换通道);主机端归一化,插件预处理和折叠归一化时均生效
+     */
+    int swapRB = 1;
+    /**
+     * 输出直接引用请求的输出blob,不拷贝;Output释放前请求不归还请求池
+     * 仅对逐张推断和异步推断生效,合并批处理和插件预处理仍拷贝到池化缓冲区
+     */
+    int borrowOutput = 0;
+    /**
+     * 默认取出的输出层(.config中outputs=name1,name2),为空时取全部输出层
+     */
+    std::vector<std::string> outputs;
+    /**
+     * 可执行网络副本数,不为1时开启吞吐模式:每个副本单线程推断并绑定到不同的物理核,
+     * 推断分发到未完成任务最少的副本;0为每个物理核一个副本
+     */
+    int replicas = 1;
+    /**
+     * NUMA感知:副本均匀分布在各NUMA节点,网络权重,请求blob和均值表在副本所在节点首次访问,
+     * 推断优先路由到调用线程所在节点的副本;只在吞吐模式下生效
+     */
+    int numa = 0;
+    /**
+     * 预热:每个窗口的推断次数(0为不预热),最多推断次数,相邻窗口p99延迟的相对容差
+     */
+    int warmUpRounds = 20;
+    int warmUpMaxRounds = 400;
+    float warmUpTolerance = 0.1f;
+    /**
+     * 覆盖.config的参数(如JNI创建时传入),读取.config后依次通过setOption设置
+     */
+    std::vector<std::pair<std::string, std::string>> overrides;
+
+    /**
+     * 解析"key=value;key=value"形式的参数,加入overrides
+     */
+    void addOverrides(const std::string &options);
+    /**
+     * CPU插件是否绑定线程到核;为插件级设置,以同一设备上第一个创建的模型为准
+     */
+    int bindThread = 1;
+    /**
+     * 自定义扩展库路径(.config中extension=),同一路径在进程中只加载一次
+     */
+    std::string extensionLib;
+    /**
+     * 结果导出编码(.config中outputEncoding=fp32/fp16/int8),非FP32时只保留编码后的结果
+     */
+    OutputEncoding outputEncoding = OutputEncoding::FP32;
+    /**
+     * 多视图结果归约(.config中reduction=none/mean/max/l2mean),非NONE时每张图片只返回一行结果,先归约再编码
+     */
+    ViewReduction reduction = ViewReduction::NONE;
+    /**
+     * 默认推断模式(.config中inferenceMode=throughput/latency),可在每次调用时指定
+     */
+    InferenceMode inferenceMode = InferenceMode::THROUGHPUT;
+    /**
+     * 延迟模式下一张图片最多拆分的请求数,大于1时开启动态batch以支持延迟模式,否则延迟模式退化为吞吐模式
+     */
+    int latencyParts = 0;
+    /**
+     * 自适应TTA(.config中earlyExitCosine=),大于0时先推断中心视图及其翻转视图(无翻转时为另一个裁剪视图),
+     * 两者第一个输出层的余弦相似度不低于该阈值时只归约这两个视图,否则再推断其余视图;
+     * 只在开启reduction且逐张推断(或吞吐模式副本)时生效
+     */
+    float earlyExitCosine = 0;
+    /**
+     * INT8统计文件(.config中int8Stats=,相对路径基于modelDir),由校准工具ddup_calibrate生成;
+     * 设置后CPU插件按统计量运行INT8
+     */
+    std::string int8Stats;
+    /**
+     * 特征层(.config中featureLayers=name1,name2):加载前从模型描述中删除特征层下游的层(如分类头),
+     * 特征层作为输出层,未配置outputs时为默认输出层
+     */
+    std::vector<std::string> featureLayers;
+    /**
+     * 分辨率分桶(.config中buckets=224_224,192_288,顺序同width_height_channel):每个分桶加载一个输入reshape为该大小的网络,
+     * 图片路由到宽高比最接近的网络(含.config中的默认大小),减少缩放拉伸;只在不裁剪(cropNum=0)时生效
+     */
+    std::vector<std::pair<int, int>> buckets;
+    /**
+     * 归一化折叠(.config中foldMean=1):加载时把减均值,除以scale和BGR->RGB交换折叠进第一个卷积的权重和偏置,
+     * 推断时输入blob为BGR原始u8像素(NHWC),只做缩放和裁剪;
+     * 均值文件按通道均值折叠(逐像素差异被忽略),第一个卷积有padding时边界输出为近似值
+     */
+    int foldMean = 0;
+    /**
+     * 校准模式:网络中所有层都作为输出层,供校准工具收集各层统计量
+     */
+    int calibrate = 0;
+
+    /**
+     * 单张图片的视图数(裁剪数 x 翻转)
+     */
+    int viewNum() const {
+        int num = pImageInfo->cropNum == 0 ? 1 : pImageInfo->cropNum;
+        return pImageInfo->flip == 1 ? 2 * num : num;
+    }
+
+    /**
+     * 设置可选参数(.config中的key=value行)
+     * @return 是否识别该参数
+     */
+    int setOption(const std::string &key, const std::string &value);
 
     void toString() {
         printf("Config information:\n"
@@ -105,28 +266,43 @@ struct Config {
                "flip:%d\n"
                "meanFile:%s\n"
                "scale:%f\n"
-               "corpW_cropH_cropN:%d_%d_%d\n", modelDir.c_str(), modelName.c_str(), pImageInfo->width,
+               "corpW_cropH_cropN:%d_%d_%d\n"
+               "requestNum:%d\n"
+               "batchImages_batchWaitUs:%d_%d\n"
+               "borrowOutput:%d\n"
+               "replicas:%d\n"
+               "reduction:%d\n", modelDir.c_str(), modelName.c_str(), pImageInfo->width,
                pImageInfo->height, pImageInfo->channel, pImageInfo->flip, pImageInfo->meanFile.c_str(),
                pImageInfo->scale,
-               pImageInfo->corpSize_W, pImageInfo->cropSize_H, pImageInfo->cropNum);
+               pImageInfo->corpSize_W, pImageInfo->cropSize_H, pImageInfo->cropNum, requestNum,
+               batchImages, batchWaitUs, borrowOutput, replicas,
+               static_cast<int>(reduction));
         for (int i = 0; i < pImageInfo->cropNum; ++i) {
             printf("x_y:%d_%d\n", pImageInfo->corpPoint[i][0], pImageInfo->corpPoint[i][1]);
         }
     }
 };
 
-class Output {
+/**
+ * 一个输出层的推断结果
+ * 结果缓冲区来自进程级缓冲区池,同一个Output重复使用时复用缓冲区;
+ * 开启borrowOutput时直接引用请求的输出blob,结果释放(或reset)前该请求不归还请求池
+ */
+class OutputTensor {
 public:
-    Output() : data(nullptr){}
-    ~Output(){
-        if (data) {
-            free(data);
-        }
+    OutputTensor() : data(nullptr) {}
+    ~OutputTensor() {
+        reset();
     }
+    OutputTensor(const OutputTensor &) = delete;
+    OutputTensor &operator=(const OutputTensor &) = delete;
+    OutputTensor(OutputTensor &&other) noexcept;
+    OutputTensor &operator=(OutputTensor &&other) noexcept;
+
     /**
-     * 输出shape
+     * 输出shape(完整维度,第一维为视图数)
      */
-    size_t shape[4]={1};
+    std::vector<size_t> shape;
     /**
      * 输出头指针
      */
@@ -139,35 +315,249 @@ public:
         }
         return dim;
     }
+
+    /**
+     * 准备至少size个float的结果缓冲区,已有缓冲区足够大时直接复用
+     */
+    float *allocate(size_t size);
+
+    /**
+     * 引用外部内存作为结果,owner在结果释放前保持外部内存有效
+     */
+    void borrow(float *pData, std::shared_ptr<void> owner);
+
+    /**
+     * 释放float结果(缓冲区归还缓冲区池,或解除对外部内存的引用)
+     */
+    void reset();
+
+    /**
+     * 当前有效的编码结果,FP32时结果在data中
+     */
+    OutputEncoding encoding = OutputEncoding::FP32;
+    /**
+     * FP16结果
+     */
+    std::vector<uint16_t> fp16;
+    /**
+     * int8结果,及每个向量(第一维的每一行)的scale,反量化为 int8 * scale
+     */
+    std::vector<int8_t> int8;
+    std::vector<float> int8Scale;
+
+    /**
+     * 把结果编码为encoding,pSrc为空时从data编码;编码缓冲区在同一个结果重复使用时复用
+     */
+    void encode(OutputEncoding encoding, const float *pSrc = nullptr);
+
+private:
+    /**
+     * 缓冲区池中缓冲区的容量,引用外部内存时为0
+     */
+    size_t capacity = 0;
+    /**
+     * 被引用的外部内存的持有者
+     */
+    std::shared_ptr<void> owner;
 };
 
-class Openvino_Net {
+/**
+ * 推断结果,按输出层名称索引
+ * 只取出names中的输出层,其余输出层不从插件拷出
+ */
+class Output {
 public:
-    explicit Openvino_Net(Config &config) : config(config), meanArr(nullptr) {}
-    ~Openvino_Net(){
-        if (meanArr) {
-            free(meanArr);
+    Output() = default;
+    Output(const Output &) = delete;
+    Output &operator=(const Output &) = delete;
+    Output(Output &&) = default;
+    Output &operator=(Output &&) = default;
+
+    /**
+     * 需要取出的输出层,为空时取Config::outputs(仍为空时取网络的全部输出层),推断后填入实际取出的输出层
+     */
+    std::vector<std::string> names;
+    /**
+     * 各输出层结果
+     */
+    std::map<std::string, OutputTensor> tensors;
+
+    /**
+     * 按名称获取结果,没有该输出层时抛出std::out_of_range
+     */
+    OutputTensor &operator[](const std::string &name) {
+        return tensors.at(name);
+    }
+
+    /**
+     * 第一个输出层的结果(单输出网络的唯一结果)
+     */
+    OutputTensor &first() {
+        if (names.empty()) {
+            throw std::out_of_range("output is empty");
         }
+        return tensors.at(names.front());
     }
+
+    /**
+     * 释放全部结果
+     */
+    void reset() {
+        tensors.clear();
+    }
+};
+
+/**
+ * 异步推断完成回调, status为OK时output有效
+ */
+typedef std::function<void(Output &output, StatusCode status)> InferenceCallback;
+
+class Openvino_Net {
+public:
+    explicit Openvino_Net(Config &config) : config(config) {}
+
+    /**
+     * 等待所有借出的请求完成,完成回调不会在析构后访问本对象
+     */
+    ~Openvino_Net();
+
     /**
     * 构建一个openvino的推断引擎
     */
     int create_inf_engine();
 
     /**
-     * 推断
+     * 推断,使用配置的推断模式
      */
     void inference(Output &output, unsigned char *pImageHead, int imageW, int imageH);
 
+    /**
+     * 按指定模式推断
+     */
+    void inference(Output &output, unsigned char *pImageHead, int imageW, int imageH, InferenceMode mode);
+
+    /**
+     * 预热:用合成图片推断直到p99延迟稳定,消除首次推断的延迟;create_inf_engine结束前调用
+     */
+    void warm_up();
+
+    /**
+     * 是否已完成预热
+     */
+    bool isReady() const {
+        return ready;
+    }
+
+    /**
+     * 异步推断,完成后在推断线程中调用callback
+     * 返回时图片数据已拷贝进请求,调用方可立即释放pImageHead;请求池无空闲请求时阻塞
+     */
+    void inference_async(unsigned char *pImageHead, int imageW, int imageH, const InferenceCallback &callback);
+
+    /**
+     * 异步推断,通过future获取结果
+     */
+    std::future<std::shared_ptr<Output>> inference_async(unsigned char *pImageHead, int imageW, int imageH);
+
+    /**
+     * 预处理签名:签名相同的网络输入blob内容相同,可以共享一次预处理
+     * 不能共享预处理(插件预处理,合并批处理,自适应TTA,分辨率分桶,多输入)时返回空串
+     */
+    std::string preprocess_signature() const;
+
+    /**
+     * 一张图片预处理结果的字节数
+     */
+    size_t preprocess_bytes() const;
+
+    /**
+     * 预处理一张图片的全部视图,按输入blob布局写入pDst(preprocess_bytes字节)
+     */
+    void preprocess(unsigned char *pImageHead, int imageW, int imageH, void *pDst);
+
+    /**
+     * 用共享的预处理结果启动推断,返回等待推断完成并收集结果的函数;等待完成前pInput和output必须有效
+     */
+    std::function<void()> start_preprocessed(Output &output, const void *pInput);
+
 private:
+    /**
+     * 异步推断中的请求状态
+     */
+    struct AsyncJob {
+        InferRequest::Ptr request;
+        std::shared_ptr<Output> output;
+        InferenceCallback callback;
+    };
+
+    /**
+     * 合并批处理中的一个批次
+     */
+    struct BatchGroup {
+        InferRequest::Ptr request;
+        /**
+         * 已领取/已写完的槽位数
+         */
+        int claimed = 0, written = 0;
+        /**
+         * 是否已封口(不再接受新图片),是否已完成推断
+         */
+        bool sealed = false, finished = false;
+        /**
+         * 各槽位调用者的输出
+         */
+        std::vector<Output *> outputs;
+        std::chrono::steady_clock::time_point deadline;
+        std::exception_ptr error;
+    };
     /**
      * 可执行网络结构
      */
     ExecutableNetwork executableNetwork;
     /**
-     * 插件
+     * 预先创建的推断请求池
+     */
+    InferRequestPool requestPool;
+    /**
+     * 输入层/输出层名称,创建引擎时缓存,避免推断时重复获取网络信息
+     */
+    std::vector<std::string> inputNames, outputNames;
+    /**
+     * 调用方未指定时取出的输出层
+     */
+    std::vector<std::string> defaultOutputs;
+    /**
+     * 各输出层的形状
+     */
+    std::map<std::string, SizeVector> outputDims;
+    /**
+     * 分辨率分桶的网络
+     */
+    std::vector<std::unique_ptr<Openvino_Net>> bucketNets;
+    /**
+     * 自适应TTA的视图推断顺序:前两个为先行推断的视图,其后为其余视图;为空时未开启
+     */
+    std::vector<int> adaptiveViews;
+    /**
+     * 请求池中每个请求对应的异步状态,创建引擎时建立,之后只在asyncMutex下查找;
+     * 每个任务只由借出该请求的线程和其完成回调访问
+     */
+    std::map<InferRequest *, AsyncJob> asyncJobs;
+    std::mutex asyncMutex;
+    /**
+     * 合并批处理中正在接受图片的批次
+     */
+    std::shared_ptr<BatchGroup> openBatch;
+    std::mutex batchMutex;
+    std::condition_variable batchCond;
+    /**
+     * 插件,来自模型注册表,同一设备的所有模型共享
      */
     InferencePlugin plugin;
+    /**
+     * 内存映射的权重,网络存在期间保持映射
+     */
+    std::shared_ptr<const MappedWeights> weights;
     /**
      * 模型网络信息
      */
@@ -177,34 +567,177 @@ private:
      */
     Config config;
     /**
-     * 均值数组头指针
+     * 分桶网络自己持有的config.pImageInfo,其他网络为空;先于副本声明,副本析构时仍有效
+     */
+    std::unique_ptr<ImageInfo> ownedImageInfo;
+    /**
+     * 均值表,来自进程级均值缓存,已按网络输入布局预计算mean / scale
+     */
+    std::shared_ptr<const MeanTable> meanTable;
+    /**
+     * 是否已完成预热
+     */
+    std::atomic<bool> ready{false};
+    /**
+     * 吞吐模式下的一个绑核副本
+     */
+    struct ReplicaSlot {
+        /**
+         * 副本所在NUMA节点
+         */
+        int node = 0;
+        /**
+         * NUMA模式下副本所在节点的均值表,为空时使用共享均值表
+         */
+        std::shared_ptr<const MeanTable> meanTable;
+        /**
+         * 最后声明,最先析构
+         */
+        std::unique_ptr<NetReplica> replica;
+    };
+    /**
+     * 逻辑CPU所在NUMA节点,用于把请求路由到调用线程所在节点的副本
      */
-    float *meanArr;
+    std::vector<int> cpuNodes;
+    /**
+     * 吞吐模式下的绑核副本;最后声明,最先析构,保证副本线程中的任务不会访问已析构的成员
+     */
+    std::vector<ReplicaSlot> replicas;
+    std::atomic<unsigned> nextReplica{0};
 
     /**
     * 读取配置文件
     */
     int read_config();
 
+    /**
+    * 查找请求对应的异步状态
+    */
+    AsyncJob &async_job(InferRequest *pRequest);
+
+    /**
+    * 获取均值表
+    */
+    int load_mean_table();
+
     /**
     * 读取模型网络信息
     */
     int read_net();
 
+    /**
+    * 设置插件预处理的按像素均值图
+    */
+    void set_mean_image(PreProcessInfo &preProcess);
+
     /**
     * 填充请求数据
+    * pViews不为空时只按顺序填充pViews中的viewCount个视图
+    */
+    void fill_data(InferRequest &inferRequest, Config &config, unsigned char *pImageHead, int imageW, int imageH,
+                   int batchOffset = 0, const MeanTable *pMeanTable = nullptr, const int *pViews = nullptr,
+                   int viewCount = 0);
+
+    /**
+    * 收集推断结果,只取出output.names(或默认输出层)中的输出层
+    * batchCount > 0时只收集[batchOffset, batchOffset + batchCount)的结果
+    * owner不为空时结果直接引用输出blob并由owner保持请求不被归还,否则拷贝到池化缓冲区
+    */
+    void collectOutPut(InferRequest &inferRequest, Config &config, Output &output, int batchOffset = 0,
+                       int batchCount = 0, const std::shared_ptr<void> &owner = nullptr);
+
+    /**
+    * 按视图顺序拼接多个请求的结果
+    */
+    void collectViews(std::vector<InferRequest::Ptr> &requests, Output &output);
+
+    /**
+    * 按视图数分配结果缓冲区
+    */
+    void prepare_views(Output &output);
+
+    /**
+    * 把请求中的count个视图结果拷贝到第firstView个视图开始的位置
+    */
+    void copy_views(InferRequest &inferRequest, Output &output, int firstView, int count);
+
+    /**
+    * 视图拷贝完成后归约和编码
+    */
+    void finish_views(Output &output);
+
+    /**
+    * 延迟模式推断
+    */
+    void inference_latency(Output &output, unsigned char *pImageHead, int imageW, int imageH);
+
+    /**
+    * 缩放图片到网络输入大小,缩放缓冲区按线程复用;大小一致时直接返回原图
+    */
+    unsigned char *resize_input(unsigned char *pImageHead, int imageW, int imageH);
+
+    /**
+    * 创建分辨率分桶的网络
+    */
+    int create_buckets();
+
+    /**
+    * 选择宽高比与图片最接近的网络,自身最接近时返回nullptr
+    */
+    Openvino_Net *route_bucket(int imageW, int imageH);
+
+    /**
+    * 选择自适应TTA的视图顺序,条件不满足时关闭自适应TTA
+    */
+    void init_adaptive_views();
+
+    /**
+    * 自适应TTA推断
+    */
+    void inference_adaptive(Output &output, unsigned char *pImageHead, int imageW, int imageH);
+
+    /**
+    * 在一个请求中先推断先行视图,不一致时再推断其余视图;pImageHead为已缩放的图片
+    */
+    void infer_adaptive(InferRequest &inferRequest, Output &output, unsigned char *pImageHead,
+                        const MeanTable *pMeanTable);
+
+    /**
+    * 插件预处理推断
+    */
+    void inference_plugin_preprocess(Output &output, unsigned char *pImageHead, int imageW, int imageH);
+
+    /**
+    * 每个池化请求(或每个副本)各推断一次
+    */
+    void warm_up_requests(unsigned char *pImageHead, int imageW, int imageH);
+
+    /**
+    * 创建绑核的网络副本
+    */
+    int create_replicas();
+
+    /**
+    * 选择未完成任务最少的副本,NUMA模式下优先选择调用线程所在节点的副本
+    */
+    ReplicaSlot &least_loaded_replica();
+
+    /**
+    * 合并批处理推断
     */
-    void fill_data(InferRequest &inferRequest, Config &config, unsigned char *pImageHead, int imageW, int imageH);
+    void inference_batched(Output &output, unsigned char *pImageHead, int imageW, int imageH);
 
     /**
-    * 收集推断结果
+    * 异步请求完成处理
     */
-    void collectOutPut(InferRequest &inferRequest, Config &config, Output &output);
+    void on_async_complete(InferRequest *pRequest, StatusCode status);
 
     /**
     * 图片增强逻辑
+    * phead为float输入blob,开启foldMean时为u8输入blob
     */
-    void ex_pic(float *phead, Config &config, unsigned char *pImageHead, int imageW, int imageH);
+    void ex_pic(void *phead, Config &config, unsigned char *pImageHead, int imageW, int imageH,
+                const MeanTable *pMeanTable, const int *pViews = nullptr, int viewCount = 0);
 };
 
 #endif //DDUP_MOGU_OPENVINO_H
@@ -3,8 +3,8 @@
 //
 
 #include "mogu_openvino_jni.h"
-
-static std::map<std::string, Openvino_Net *> netPool;
+#include "mogu_model_registry.h"
+#include "mogu_multi_model.h"
 
 inline void get_string(JNIEnv *env, jstring jstr, std::string &str) {
     const char *pJstr = env->GetStringUTFChars(jstr, nullptr);
@@ -28,10 +28,66 @@ JNIEXPORT jint JNICALL Java_com_mogujie_algo_openvino_jni_MoguOpenvino_create
     config.modelDir = modelDirStr;
     config.modelName = modelNameStr;
 
-    auto *net = new Openvino_Net(config);
-    net->create_inf_engine();
-    netPool.insert(std::map<std::string, Openvino_Net *>::value_type(modelNameStr, net));
-    return 1;
+    /** 注册到进程级模型注册表,同名模型已存在时在后台热更新 **/
+    return ModelRegistry::instance().reload(modelNameStr, config) ? 1 : 0;
+}
+
+/*
+ * Class:     com_mogujie_algo_openvino_jni_MoguOpenvino
+ * Method:    createEx
+ * Signature: (Ljava/lang/String;Ljava/lang/String;Ljava/lang/String;)I
+ * options为"key=value;key=value",优先于.config中的同名参数,如"replicas=0;numa=1"
+ * 同名模型已存在时在后台热更新
+ */
+JNIEXPORT jint JNICALL Java_com_mogujie_algo_openvino_jni_MoguOpenvino_createEx
+        (JNIEnv *env, jclass cls, jstring jModelDir, jstring jModelName, jstring jOptions) {
+
+    std::string modelDirStr;
+    std::string modelNameStr;
+    std::string optionsStr;
+    get_string(env, jModelDir, modelDirStr);
+    get_string(env, jModelName, modelNameStr);
+    get_string(env, jOptions, optionsStr);
+    Config config;
+    config.modelDir = modelDirStr;
+    config.modelName = modelNameStr;
+    config.addOverrides(optionsStr);
+
+    return ModelRegistry::instance().reload(modelNameStr, config) ? 1 : 0;
+}
+
+/**
+ * 用指定模型推断一张图片,返回第一个输出层(可在.config中用outputs=指定)
+ * @return 模型不存在时返回nullptr
+ */
+static OutputTensor *run_inference(JNIEnv *env, jstring mn, jcharArray charArr, jint w, jint h, Output &output) {
+    std::string modelName;
+    get_string(env, mn, modelName);
+    std::shared_ptr<Openvino_Net> pNet = ModelRegistry::instance().find(modelName);
+    if (!pNet) {
+        return nullptr;
+    }
+
+    jchar *pJchar = env->GetCharArrayElements(charArr, nullptr);
+    auto *data = (unsigned char *) pJchar;
+    pNet->inference(output, data, (int) w, (int) h);
+    env->ReleaseCharArrayElements(charArr, pJchar, JNI_ABORT);
+    return &output.first();
+}
+
+/**
+ * 检查结果是否为float;模型配置了outputEncoding=fp16/int8时只有编码结果,抛出IllegalStateException
+ * @return 是否为float结果
+ */
+static int check_float_output(JNIEnv *env, const OutputTensor &tensor) {
+    if (tensor.encoding == OutputEncoding::FP32) {
+        return 1;
+    }
+    const char *encoding = tensor.encoding == OutputEncoding::FP16 ? "fp16, use inferenceFP16"
+                                                                   : "int8, use inferenceInt8";
+    std::string message = std::string("model is configured with outputEncoding=") + encoding;
+    env->ThrowNew(env->FindClass("java/lang/IllegalStateException"), message.c_str());
+    return 0;
 }
 
 /*
@@ -42,29 +98,147 @@ JNIEXPORT jint JNICALL Java_com_mogujie_algo_openvino_jni_MoguOpenvino_create
 JNIEXPORT jfloatArray JNICALL Java_com_mogujie_algo_openvino_jni_MoguOpenvino_inference
         (JNIEnv * env, jclass cls, jstring mn, jcharArray charArr, jint w, jint h, jint c){
 
-    const char *pJstr = env->GetStringUTFChars(mn, nullptr);
-    std::string modelName(pJstr);
+    jfloatArray outputDataArr = nullptr;
+    Output output;
+    OutputTensor *pTensor = run_inference(env, mn, charArr, w, h, output);
+    if (pTensor && check_float_output(env, *pTensor) && pTensor->data) {
+        outputDataArr = env->NewFloatArray(pTensor->getTotalDim());
+        env->SetFloatArrayRegion(outputDataArr, 0, pTensor->getTotalDim(), pTensor->data);
+    }
+    return outputDataArr;
+}
 
-    jchar *pJchar = env->GetCharArrayElements(charArr, nullptr);
-    jint size = env->GetArrayLength(charArr);
-    auto *data = (unsigned char *) pJchar;
+/*
+ * Class:     com_mogujie_algo_openvino_jni_MoguOpenvino
+ * Method:    inferenceFP16
+ * Signature: (Ljava/lang/String;[CIII)[S
+ */
+JNIEXPORT jshortArray JNICALL Java_com_mogujie_algo_openvino_jni_MoguOpenvino_inferenceFP16
+        (JNIEnv *env, jclass cls, jstring mn, jcharArray charArr, jint w, jint h, jint c) {
 
-    Openvino_Net *pNet = netPool.find(modelName)->second;
+    jshortArray outputDataArr = nullptr;
+    Output output;
+    OutputTensor *pTensor = run_inference(env, mn, charArr, w, h, output);
+    if (pTensor) {
+        /** 模型未配置outputEncoding=fp16时在此编码 **/
+        if (pTensor->encoding != OutputEncoding::FP16) {
+            if (!pTensor->data) {
+                return nullptr;
+            }
+            pTensor->encode(OutputEncoding::FP16);
+        }
+        auto size = static_cast<jsize>(pTensor->fp16.size());
+        outputDataArr = env->NewShortArray(size);
+        env->SetShortArrayRegion(outputDataArr, 0, size, reinterpret_cast<const jshort *>(pTensor->fp16.data()));
+    }
+    return outputDataArr;
+}
 
-    jfloatArray outputDataArr = nullptr;
-    if (pNet) {
-        auto output = new Output();
-        pNet->inference(*output, data, (int) w, (int) h);
+/*
+ * Class:     com_mogujie_algo_openvino_jni_MoguOpenvino
+ * Method:    inferenceInt8
+ * Signature: (Ljava/lang/String;[CIII)[B
+ * 每个向量依次为4字节小端float scale和该向量的int8结果,反量化为 int8 * scale
+ */
+JNIEXPORT jbyteArray JNICALL Java_com_mogujie_algo_openvino_jni_MoguOpenvino_inferenceInt8
+        (JNIEnv *env, jclass cls, jstring mn, jcharArray charArr, jint w, jint h, jint c) {
 
-        outputDataArr = env->NewFloatArray(output->getTotalDim());
-        env->SetFloatArrayRegion(outputDataArr, 0, output->getTotalDim(), output->data);
-        delete (output);
+    jbyteArray outputDataArr = nullptr;
+    Output output;
+    OutputTensor *pTensor = run_inference(env, mn, charArr, w, h, output);
+    if (pTensor) {
+        /** 模型未配置outputEncoding=int8时在此编码 **/
+        if (pTensor->encoding != OutputEncoding::INT8) {
+            if (!pTensor->data) {
+                return nullptr;
+            }
+            pTensor->encode(OutputEncoding::INT8);
+        }
+        size_t rows = pTensor->int8Scale.size();
+        size_t rowDim = rows ? pTensor->int8.size() / rows : 0;
+        size_t rowBytes = sizeof(float) + rowDim;
+        outputDataArr = env->NewByteArray(static_cast<jsize>(rows * rowBytes));
+        for (size_t r = 0; r < rows; ++r) {
+            auto offset = static_cast<jsize>(r * rowBytes);
+            env->SetByteArrayRegion(outputDataArr, offset, sizeof(float),
+                                    reinterpret_cast<const jbyte *>(&pTensor->int8Scale[r]));
+            env->SetByteArrayRegion(outputDataArr, offset + sizeof(float), static_cast<jsize>(rowDim),
+                                    reinterpret_cast<const jbyte *>(pTensor->int8.data() + r * rowDim));
+        }
     }
-    env->ReleaseCharArrayElements(charArr, pJchar, size);
-    env->ReleaseStringUTFChars(mn, pJstr);
     return outputDataArr;
 }
 
+/*
+ * Class:     com_mogujie_algo_openvino_jni_MoguOpenvino
+ * Method:    inferenceMulti
+ * Signature: ([Ljava/lang/String;[CIII)[[F
+ * 同一张图片交给多个模型,预处理相同的模型共享一次预处理并发推断;按模型顺序返回各自第一个输出层,模型不存在时为null
+ */
+JNIEXPORT jobjectArray JNICALL Java_com_mogujie_algo_openvino_jni_MoguOpenvino_inferenceMulti
+        (JNIEnv *env, jclass cls, jobjectArray modelNames, jcharArray charArr, jint w, jint h, jint c) {
+
+    jsize modelNum = env->GetArrayLength(modelNames);
+    std::vector<std::shared_ptr<Openvino_Net>> nets;
+    std::vector<jsize> slots;
+    for (jsize i = 0; i < modelNum; ++i) {
+        auto jModelName = static_cast<jstring>(env->GetObjectArrayElement(modelNames, i));
+        std::string modelName;
+        get_string(env, jModelName, modelName);
+        env->DeleteLocalRef(jModelName);
+        std::shared_ptr<Openvino_Net> pNet = ModelRegistry::instance().find(modelName);
+        if (pNet) {
+            nets.push_back(pNet);
+            slots.push_back(i);
+        }
+    }
+
+    std::vector<Output> outputs;
+    jchar *pJchar = env->GetCharArrayElements(charArr, nullptr);
+    /** C++异常不能穿过JVM栈帧,释放数组后转为Java异常 **/
+    try {
+        inference_multi(nets, outputs, (unsigned char *) pJchar, (int) w, (int) h);
+    } catch (const std::exception &error) {
+        env->ReleaseCharArrayElements(charArr, pJchar, JNI_ABORT);
+        env->ThrowNew(env->FindClass("java/lang/RuntimeException"), error.what());
+        return nullptr;
+    }
+    env->ReleaseCharArrayElements(charArr, pJchar, JNI_ABORT);
+
+    jobjectArray outputArr = env->NewObjectArray(modelNum, env->FindClass("[F"), nullptr);
+    for (size_t i = 0; i < outputs.size(); ++i) {
+        if (outputs[i].names.empty()) {
+            continue;
+        }
+        OutputTensor &tensor = outputs[i].first();
+        if (!check_float_output(env, tensor)) {
+            return nullptr;
+        }
+        if (!tensor.data) {
+            continue;
+        }
+        jfloatArray outputDataArr = env->NewFloatArray(tensor.getTotalDim());
+        env->SetFloatArrayRegion(outputDataArr, 0, tensor.getTotalDim(), tensor.data);
+        env->SetObjectArrayElement(outputArr, slots[i], outputDataArr);
+        env->DeleteLocalRef(outputDataArr);
+    }
+    return outputArr;
+}
+
+/*
+ * Class:     com_mogujie_algo_openvino_jni_MoguOpenvino
+ * Method:    isReady
+ * Signature: (Ljava/lang/String;)Z
+ */
+JNIEXPORT jboolean JNICALL Java_com_mogujie_algo_openvino_jni_MoguOpenvino_isReady
+        (JNIEnv *env, jclass cls, jstring jstr) {
+
+    std::string modelName;
+    get_string(env, jstr, modelName);
+    std::shared_ptr<Openvino_Net> pNet = ModelRegistry::instance().find(modelName);
+    return pNet && pNet->isReady() ? JNI_TRUE : JNI_FALSE;
+}
+
 /*
  * Class:     com_mogujie_algo_openvino_jni_MoguOpenvino
  * Method:    release
@@ -75,9 +249,6 @@ JNIEXPORT void JNICALL Java_com_mogujie_algo_openvino_jni_MoguOpenvino_release
 
     std::string modelName;
     get_string(env, jstr, modelName);
-    Openvino_Net *pNet = netPool.find(modelName)->second;
-    if (pNet) {
-        delete (pNet);
-    }
+    ModelRegistry::instance().release(modelName);
 }
 
@@ -0,0 +1,337 @@
+//
+// Created by adai on 2019/01/10.
+//
+
+#include "mogu_preprocess.h"
+
+#include <immintrin.h>
+#include <cstring>
+#include <utility>
+
+/**
+ * 16个BGR像素(48字节,3个16字节块)拆分为B,G,R三个平面的pshufb掩码
+ * deinterleaveMask[通道][块]
+ */
+alignas(16) static const signed char deinterleaveMask[3][3][16] = {
+        {
+                {0, 3, 6, 9, 12, 15, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128},
+                {-128, -128, -128, -128, -128, -128, 2, 5, 8, 11, 14, -128, -128, -128, -128, -128},
+                {-128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, 1, 4, 7, 10, 13},
+        },
+        {
+                {1, 4, 7, 10, 13, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128},
+                {-128, -128, -128, -128, -128, 0, 3, 6, 9, 12, 15, -128, -128, -128, -128, -128},
+                {-128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, 2, 5, 8, 11, 14},
+        },
+        {
+                {2, 5, 8, 11, 14, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128},
+                {-128, -128, -128, -128, -128, 1, 4, 7, 10, 13, -128, -128, -128, -128, -128, -128},
+                {-128, -128, -128, -128, -128, -128, -128, -128, -128, -128, 0, 3, 6, 9, 12, 15},
+        },
+};
+
+/**
+ * 翻转时的拆分掩码,输出第j个像素取自块中第15-j个像素
+ */
+alignas(16) static const signed char deinterleaveMirrorMask[3][3][16] = {
+        {
+                {-128, -128, -128, -128, -128, -128, -128, -128, -128, -128, 15, 12, 9, 6, 3, 0},
+                {-128, -128, -128, -128, -128, 14, 11, 8, 5, 2, -128, -128, -128, -128, -128, -128},
+                {13, 10, 7, 4, 1, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128},
+        },
+        {
+                {-128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, 13, 10, 7, 4, 1},
+                {-128, -128, -128, -128, -128, 15, 12, 9, 6, 3, 0, -128, -128, -128, -128, -128},
+                {14, 11, 8, 5, 2, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128},
+        },
+        {
+                {-128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, 14, 11, 8, 5, 2},
+                {-128, -128, -128, -128, -128, -128, 13, 10, 7, 4, 1, -128, -128, -128, -128, -128},
+                {15, 12, 9, 6, 3, 0, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128},
+        },
+};
+
+/**
+ * 4个BGR像素转RGB的掩码(输入为16字节中的前12字节)
+ */
+alignas(16) static const signed char swapMask[16] = {
+        2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, -128, -128, -128, -128
+};
+
+/**
+ * 4个BGR像素翻转并转RGB的掩码(输入为16字节中的后12字节),恰好是字节逆序
+ */
+alignas(16) static const signed char swapMirrorMask[16] = {
+        15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, -128, -128, -128, -128
+};
+
+/**
+ * 不交换通道时的掩码:保持BGR,翻转时只逆序像素
+ */
+alignas(16) static const signed char keepMask[16] = {
+        0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, -128, -128, -128, -128
+};
+
+alignas(16) static const signed char keepMirrorMask[16] = {
+        13, 14, 15, 10, 11, 12, 7, 8, 9, 4, 5, 6, -128, -128, -128, -128
+};
+
+/**
+ * 标量实现,同时用于处理SIMD剩余的尾部像素
+ */
+static void normalize_row_planar_scalar(const unsigned char *pSrc, const float *pMean, int meanPlaneStride,
+                                        float invScale, float *pDst, int dstPlaneStride, int begin, int width,
+                                        int mirror, int swapRB) {
+    for (int x = begin; x < width; ++x) {
+        const unsigned char *pPixel = pSrc + (mirror ? width - 1 - x : x) * 3;
+        for (int c = 0; c < 3; ++c) {
+            float mean = pMean ? pMean[c * meanPlaneStride + x] : 0.0f;
+            pDst[c * dstPlaneStride + x] = pPixel[swapRB ? 2 - c : c] * invScale - mean;
+        }
+    }
+}
+
+static void normalize_row_interleaved_scalar(const unsigned char *pSrc, const float *pMean, float invScale,
+                                             float *pDst, int begin, int width, int mirror, int swapRB) {
+    for (int x = begin; x < width; ++x) {
+        const unsigned char *pPixel = pSrc + (mirror ? width - 1 - x : x) * 3;
+        for (int c = 0; c < 3; ++c) {
+            float mean = pMean ? pMean[x * 3 + c] : 0.0f;
+            pDst[x * 3 + c] = pPixel[swapRB ? 2 - c : c] * invScale - mean;
+        }
+    }
+}
+
+/**
+ * 从48字节BGR中取出某一通道的16个像素
+ */
+#define DEINTERLEAVE_CHANNEL(a, b, c, mask, ch)                                                              \
+    _mm_or_si128(_mm_or_si128(                                                                               \
+            _mm_shuffle_epi8(a, _mm_load_si128((const __m128i *) mask[ch][0])),                               \
+            _mm_shuffle_epi8(b, _mm_load_si128((const __m128i *) mask[ch][1]))),                              \
+            _mm_shuffle_epi8(c, _mm_load_si128((const __m128i *) mask[ch][2])))
+
+__attribute__((target("avx2")))
+static void normalize_row_planar_avx2(const unsigned char *pSrc, const float *pMean, int meanPlaneStride,
+                                      float invScale, float *pDst, int dstPlaneStride, int width, int mirror,
+                                      int swapRB) {
+    const __m256 vScale = _mm256_set1_ps(invScale);
+    const signed char (*mask)[3][16] = mirror ? deinterleaveMirrorMask : deinterleaveMask;
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        /** 翻转时输出的16个像素取自输入中对称位置的16个像素 **/
+        const unsigned char *p = pSrc + (mirror ? width - 16 - x : x) * 3;
+        __m128i a = _mm_loadu_si128((const __m128i *) p);
+        __m128i b = _mm_loadu_si128((const __m128i *) (p + 16));
+        __m128i c = _mm_loadu_si128((const __m128i *) (p + 32));
+        /** 交换通道时网络通道c取自BGR中的第2-c个通道 **/
+        __m128i planes[3] = {DEINTERLEAVE_CHANNEL(a, b, c, mask, 2), DEINTERLEAVE_CHANNEL(a, b, c, mask, 1),
+                             DEINTERLEAVE_CHANNEL(a, b, c, mask, 0)};
+        if (!swapRB) {
+            std::swap(planes[0], planes[2]);
+        }
+        for (int ch = 0; ch < 3; ++ch) {
+            float *pOut = pDst + ch * dstPlaneStride + x;
+            __m256 lo = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(planes[ch])), vScale);
+            __m256 hi = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_srli_si128(planes[ch], 8))),
+                                      vScale);
+            if (pMean) {
+                const float *pM = pMean + ch * meanPlaneStride + x;
+                lo = _mm256_sub_ps(lo, _mm256_loadu_ps(pM));
+                hi = _mm256_sub_ps(hi, _mm256_loadu_ps(pM + 8));
+            }
+            _mm256_storeu_ps(pOut, lo);
+            _mm256_storeu_ps(pOut + 8, hi);
+        }
+    }
+    normalize_row_planar_scalar(pSrc, pMean, meanPlaneStride, invScale, pDst, dstPlaneStride, x, width, mirror,
+                                swapRB);
+}
+
+__attribute__((target("sse4.1")))
+static void normalize_row_planar_sse41(const unsigned char *pSrc, const float *pMean, int meanPlaneStride,
+                                       float invScale, float *pDst, int dstPlaneStride, int width, int mirror,
+                                       int swapRB) {
+    const __m128 vScale = _mm_set1_ps(invScale);
+    const signed char (*mask)[3][16] = mirror ? deinterleaveMirrorMask : deinterleaveMask;
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        /** 翻转时输出的16个像素取自输入中对称位置的16个像素 **/
+        const unsigned char *p = pSrc + (mirror ? width - 16 - x : x) * 3;
+        __m128i a = _mm_loadu_si128((const __m128i *) p);
+        __m128i b = _mm_loadu_si128((const __m128i *) (p + 16));
+        __m128i c = _mm_loadu_si128((const __m128i *) (p + 32));
+        __m128i planes[3] = {DEINTERLEAVE_CHANNEL(a, b, c, mask, 2), DEINTERLEAVE_CHANNEL(a, b, c, mask, 1),
+                             DEINTERLEAVE_CHANNEL(a, b, c, mask, 0)};
+        if (!swapRB) {
+            std::swap(planes[0], planes[2]);
+        }
+        for (int ch = 0; ch < 3; ++ch) {
+            float *pOut = pDst + ch * dstPlaneStride + x;
+            const float *pM = pMean ? pMean + ch * meanPlaneStride + x : nullptr;
+            __m128i plane = planes[ch];
+            for (int i = 0; i < 4; ++i) {
+                __m128 v = _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepu8_epi32(plane)), vScale);
+                if (pM) {
+                    v = _mm_sub_ps(v, _mm_loadu_ps(pM + i * 4));
+                }
+                _mm_storeu_ps(pOut + i * 4, v);
+                plane = _mm_srli_si128(plane, 4);
+            }
+        }
+    }
+    normalize_row_planar_scalar(pSrc, pMean, meanPlaneStride, invScale, pDst, dstPlaneStride, x, width, mirror,
+                                swapRB);
+}
+
+#undef DEINTERLEAVE_CHANNEL
+
+/**
+ * 交错布局每次处理4个像素(12字节->12个float),128位宽度正好,不再区分AVX2
+ */
+__attribute__((target("sse4.1")))
+static void normalize_row_interleaved_sse41(const unsigned char *pSrc, const float *pMean, float invScale,
+                                            float *pDst, int width, int mirror, int swapRB) {
+    const __m128 vScale = _mm_set1_ps(invScale);
+    const signed char *mask = swapRB ? (mirror ? swapMirrorMask : swapMask) : (mirror ? keepMirrorMask : keepMask);
+    const __m128i vMask = _mm_load_si128((const __m128i *) mask);
+    int x = 0;
+    /** 每次读取16字节,保证不越过行尾/行首 **/
+    for (; x + 6 <= width; x += 4) {
+        /** 翻转时输出的4个像素取自输入中对称位置的4个像素,从其前4字节开始读取 **/
+        const unsigned char *p = mirror ? pSrc + (width - 4 - x) * 3 - 4 : pSrc + x * 3;
+        __m128i pixels = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) p), vMask);
+        float *pOut = pDst + x * 3;
+        for (int i = 0; i < 3; ++i) {
+            __m128 v = _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepu8_epi32(pixels)), vScale);
+            if (pMean) {
+                v = _mm_sub_ps(v, _mm_loadu_ps(pMean + x * 3 + i * 4));
+            }
+            _mm_storeu_ps(pOut + i * 4, v);
+            pixels = _mm_srli_si128(pixels, 4);
+        }
+    }
+    normalize_row_interleaved_scalar(pSrc, pMean, invScale, pDst, x, width, mirror, swapRB);
+}
+
+static void normalize_row_planar_generic(const unsigned char *pSrc, const float *pMean, int meanPlaneStride,
+                                         float invScale, float *pDst, int dstPlaneStride, int width, int mirror,
+                                         int swapRB) {
+    normalize_row_planar_scalar(pSrc, pMean, meanPlaneStride, invScale, pDst, dstPlaneStride, 0, width, mirror,
+                                swapRB);
+}
+
+static void normalize_row_interleaved_generic(const unsigned char *pSrc, const float *pMean, float invScale,
+                                              float *pDst, int width, int mirror, int swapRB) {
+    normalize_row_interleaved_scalar(pSrc, pMean, invScale, pDst, 0, width, mirror, swapRB);
+}
+
+typedef void (*NormalizeRowPlanarFunc)(const unsigned char *, const float *, int, float, float *, int, int, int,
+                                       int);
+
+typedef void (*NormalizeRowInterleavedFunc)(const unsigned char *, const float *, float, float *, int, int, int);
+
+/**
+ * 按CPU支持情况选择实现,只在首次调用时判断一次
+ */
+static NormalizeRowPlanarFunc select_normalize_row_planar() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return normalize_row_planar_avx2;
+    }
+    if (__builtin_cpu_supports("sse4.1")) {
+        return normalize_row_planar_sse41;
+    }
+    return normalize_row_planar_generic;
+}
+
+static NormalizeRowInterleavedFunc select_normalize_row_interleaved() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.1")) {
+        return normalize_row_interleaved_sse41;
+    }
+    return normalize_row_interleaved_generic;
+}
+
+/**
+ * 单行归一化,平面布局
+ */
+void normalize_row_planar(const unsigned char *pSrc, const float *pMean, int meanPlaneStride, float invScale,
+                          float *pDst, int dstPlaneStride, int width, int mirror, int swapRB) {
+    static const NormalizeRowPlanarFunc func = select_normalize_row_planar();
+    func(pSrc, pMean, meanPlaneStride, invScale, pDst, dstPlaneStride, width, mirror, swapRB);
+}
+
+/**
+ * 单行归一化,交错布局
+ */
+void normalize_row_interleaved(const unsigned char *pSrc, const float *pMean, float invScale, float *pDst,
+                               int width, int mirror, int swapRB) {
+    static const NormalizeRowInterleavedFunc func = select_normalize_row_interleaved();
+    func(pSrc, pMean, invScale, pDst, width, mirror, swapRB);
+}
+
+/**
+ * 整理均值布局
+ */
+void layout_mean(const float *pPlanarMean, int width, int height, int interleaved, int mirror, float scale,
+                 float *pDst) {
+    int planeSize = width * height;
+    for (int c = 0; c < 3; ++c) {
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                float mean = pPlanarMean[c * planeSize + y * width + (mirror ? width - 1 - x : x)] * scale;
+                if (interleaved) {
+                    pDst[(y * width + x) * 3 + c] = mean;
+                } else {
+                    pDst[c * planeSize + y * width + x] = mean;
+                }
+            }
+        }
+    }
+}
+
+/**
+ * 生成一个视图并写入输入blob
+ */
+void write_view(const unsigned char *pImage, int imageStride, int imageW, int imageH, int viewX, int viewY, int viewW,
+                int viewH, int mirror, const float *pMean, const float *pMeanMirror, float invScale, int planar,
+                float *pDst, int swapRB) {
+    /** 翻转视图的第一个输出像素对应翻转均值表中的该列 **/
+    int meanX = mirror ? imageW - viewX - viewW : viewX;
+    const float *pViewMean = mirror ? pMeanMirror : pMean;
+    int planeSize = imageW * imageH;
+    for (int y = 0; y < viewH; ++y) {
+        const unsigned char *pRow = pImage + (size_t) (viewY + y) * imageStride + viewX * 3;
+        int meanOffset = (viewY + y) * imageW + meanX;
+        if (planar) {
+            normalize_row_planar(pRow, pViewMean ? pViewMean + meanOffset : nullptr, planeSize, invScale,
+                                 pDst + y * viewW, viewW * viewH, viewW, mirror, swapRB);
+        } else {
+            normalize_row_interleaved(pRow, pViewMean ? pViewMean + meanOffset * 3 : nullptr, invScale,
+                                      pDst + y * viewW * 3, viewW, mirror, swapRB);
+        }
+    }
+}
+
+/**
+ * 生成一个u8视图并写入输入blob
+ */
+void write_view_u8(const unsigned char *pImage, int imageStride, int viewX, int viewY, int viewW, int viewH,
+                   int mirror, unsigned char *pDst) {
+    size_t rowBytes = (size_t) viewW * 3;
+    for (int y = 0; y < viewH; ++y) {
+        const unsigned char *pRow = pImage + (size_t) (viewY + y) * imageStride + viewX * 3;
+        unsigned char *pDstRow = pDst + y * rowBytes;
+        if (!mirror) {
+            memcpy(pDstRow, pRow, rowBytes);
+            continue;
+        }
+        for (int x = 0; x < viewW; ++x) {
+            const unsigned char *pPixel = pRow + (viewW - 1 - x) * 3;
+            pDstRow[x * 3] = pPixel[0];
+            pDstRow[x * 3 + 1] = pPixel[1];
+            pDstRow[x * 3 + 2] = pPixel[2];
+        }
+    }
+}
@@ -0,0 +1,67 @@
+//
+// Created by adai on 2019/01/10.
+//
+
+#ifndef DDUP_MOGU_PREPROCESS_H
+#define DDUP_MOGU_PREPROCESS_H
+
+/**
+ * 单行归一化,输出为平面布局(NCHW)
+ * 输入为BGR交错的u8像素,输出为R,G,B(swapRB为0时B,G,R)三个平面的float: 像素 * invScale - 均值 * invScale
+ * 运行时按CPU支持情况选择AVX2/SSE4.1/标量实现
+ * @param pSrc  BGR交错像素行
+ * @param pMean 预乘invScale的均值行,按输出平面排列,平面间距为meanPlaneStride; 为nullptr时不减均值
+ * @param invScale 归一化系数的倒数
+ * @param pDst  输出行,按输出平面排列,平面间距为dstPlaneStride
+ * @param width 像素个数
+ * @param mirror 是否水平翻转(输出第j个像素取自输入第width-1-j个像素, 均值仍按输出顺序读取)
+ * @param swapRB 是否交换通道输出RGB,否则保持BGR
+ */
+void normalize_row_planar(const unsigned char *pSrc, const float *pMean, int meanPlaneStride, float invScale,
+                          float *pDst, int dstPlaneStride, int width, int mirror = 0, int swapRB = 1);
+
+/**
+ * 单行归一化,输出为交错布局(NHWC)
+ * 输入为BGR交错的u8像素,输出为RGB(swapRB为0时BGR)交错的float: 像素 * invScale - 均值 * invScale
+ * @param pMean 预乘invScale的均值行,按输出通道交错,按输出顺序读取; 为nullptr时不减均值
+ * @param mirror 是否水平翻转
+ * @param swapRB 是否交换通道输出RGB,否则保持BGR
+ */
+void normalize_row_interleaved(const unsigned char *pSrc, const float *pMean, float invScale, float *pDst,
+                               int width, int mirror = 0, int swapRB = 1);
+
+/**
+ * 把均值文件中的RGB平面均值整理为网络输入布局
+ * @param pPlanarMean 均值文件数据, R,G,B三个平面, 每个平面height * width
+ * @param interleaved 是否整理为RGB交错布局
+ * @param mirror 是否水平翻转(供翻转视图按输出顺序读取)
+ * @param scale 预乘系数(通常为归一化系数的倒数)
+ * @param pDst 输出, width * height * 3
+ */
+void layout_mean(const float *pPlanarMean, int width, int height, int interleaved, int mirror, float scale,
+                 float *pDst);
+
+/**
+ * 生成一个视图(裁剪窗口,可翻转)并按网络输入布局直接写入输入blob
+ * @param pImage 缩放后的BGR图片
+ * @param imageStride 图片行字节数
+ * @param imageW,imageH 图片大小,同时也是均值表大小
+ * @param viewX,viewY,viewW,viewH 裁剪窗口
+ * @param pMean 预乘invScale的均值表(layout_mean整理后); pMeanMirror 翻转均值表; 为nullptr时不减均值
+ * @param planar 输出是否为平面布局(NCHW), 否则为交错布局(NHWC)
+ * @param pDst 视图在输入blob中的起始位置
+ * @param swapRB 是否交换通道输出RGB,否则保持BGR
+ */
+void write_view(const unsigned char *pImage, int imageStride, int imageW, int imageH, int viewX, int viewY, int viewW,
+                int viewH, int mirror, const float *pMean, const float *pMeanMirror, float invScale, int planar,
+                float *pDst, int swapRB = 1);
+
+/**
+ * 生成一个视图(裁剪窗口,可翻转),以BGR交错的u8原始像素写入输入blob,不做归一化
+ * 供归一化已折叠进第一个卷积的网络使用,swapRB的通道交换也已折叠进卷积权重
+ * @param pDst 视图在输入blob中的起始位置, viewW * viewH * 3
+ */
+void write_view_u8(const unsigned char *pImage, int imageStride, int viewX, int viewY, int viewW, int viewH,
+                   int mirror, unsigned char *pDst);
+
+#endif //DDUP_MOGU_PREPROCESS_H
@@ -0,0 +1,175 @@
+//
+// Created by adai on 2019/01/25.
+//
+
+#include "mogu_prune_ir.h"
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <iostream>
+
+#include <samples/slog.hpp>
+
+/**
+ * 取标签中属性的值,不存在时返回空串
+ */
+static std::string tag_attr(const std::string &tag, const std::string &name) {
+    std::string key = " " + name + "=\"";
+    size_t begin = tag.find(key);
+    if (begin == std::string::npos) {
+        return "";
+    }
+    begin += key.size();
+    size_t end = tag.find('"', begin);
+    return end == std::string::npos ? "" : tag.substr(begin, end - begin);
+}
+
+/**
+ * xml中的一段元素: [begin, end)
+ */
+struct IrElement {
+    size_t begin, end;
+    std::string tag;
+};
+
+/**
+ * 在[from, to)中查找全部名为name的元素(不嵌套),自闭合元素到"/>"结束,否则到对应的结束标签结束
+ */
+static std::vector<IrElement> find_elements(const std::string &xml, const std::string &name, size_t from, size_t to) {
+    std::vector<IrElement> elements;
+    std::string open = "<" + name;
+    std::string close = "</" + name + ">";
+    size_t pos = from;
+    while ((pos = xml.find(open, pos)) != std::string::npos && pos < to) {
+        char next = xml[pos + open.size()];
+        if (next != ' ' && next != '>' && next != '/' && next != '\n' && next != '\t' && next != '\r') {
+            pos += open.size();
+            continue;
+        }
+        size_t tagEnd = xml.find('>', pos);
+        if (tagEnd == std::string::npos) {
+            break;
+        }
+        IrElement element;
+        element.begin = pos;
+        element.tag = xml.substr(pos, tagEnd + 1 - pos);
+        if (xml[tagEnd - 1] == '/') {
+            element.end = tagEnd + 1;
+        } else {
+            size_t closePos = xml.find(close, tagEnd);
+            if (closePos == std::string::npos) {
+                break;
+            }
+            element.end = closePos + close.size();
+        }
+        elements.push_back(element);
+        pos = element.end;
+    }
+    return elements;
+}
+
+/**
+ * 元素所在区段[begin, end),不存在时返回0
+ */
+static int find_section(const std::string &xml, const std::string &name, size_t &begin, size_t &end) {
+    std::vector<IrElement> sections = find_elements(xml, name, 0, xml.size());
+    if (sections.empty()) {
+        return 0;
+    }
+    begin = sections[0].begin;
+    end = sections[0].end;
+    return 1;
+}
+
+/**
+ * 裁剪IR
+ */
+int prune_ir(const std::string &xml, const std::vector<std::string> &featureLayers, std::string &pruned) {
+    size_t layersBegin, layersEnd, edgesBegin = 0, edgesEnd = 0;
+    if (!find_section(xml, "layers", layersBegin, layersEnd)) {
+        slog::err << "no <layers> in model xml" << slog::endl;
+        return 0;
+    }
+    find_section(xml, "edges", edgesBegin, edgesEnd);
+
+    std::vector<IrElement> layers = find_elements(xml, "layer", layersBegin + 1, layersEnd);
+    std::vector<IrElement> edges = find_elements(xml, "edge", edgesBegin, edgesEnd);
+    std::map<std::string, std::string> idByName, nameById;
+    for (const auto &layer : layers) {
+        std::string id = tag_attr(layer.tag, "id");
+        std::string name = tag_attr(layer.tag, "name");
+        idByName[name] = id;
+        nameById[id] = name;
+    }
+    std::multimap<std::string, std::string> producers;
+    for (const auto &edge : edges) {
+        producers.emplace(tag_attr(edge.tag, "to-layer"), tag_attr(edge.tag, "from-layer"));
+    }
+
+    /** 从特征层沿边反向遍历,得到需要保留的层 **/
+    std::set<std::string> keep;
+    std::vector<std::string> pending;
+    for (const auto &name : featureLayers) {
+        auto item = idByName.find(name);
+        if (item == idByName.end()) {
+            slog::err << "feature layer not found in model xml: " << name << slog::endl;
+            return 0;
+        }
+        pending.push_back(item->second);
+    }
+    while (!pending.empty()) {
+        std::string id = pending.back();
+        pending.pop_back();
+        if (!keep.insert(id).second) {
+            continue;
+        }
+        auto range = producers.equal_range(id);
+        for (auto item = range.first; item != range.second; ++item) {
+            pending.push_back(item->second);
+        }
+    }
+    std::set<std::string> keepNames;
+    for (const auto &id : keep) {
+        keepNames.insert(nameById[id]);
+    }
+
+    /** 被删除的区间,按位置排序 **/
+    std::vector<std::pair<size_t, size_t>> removed;
+    for (const auto &layer : layers) {
+        if (!keep.count(tag_attr(layer.tag, "id"))) {
+            removed.emplace_back(layer.begin, layer.end);
+        }
+    }
+    for (const auto &edge : edges) {
+        if (!keep.count(tag_attr(edge.tag, "from-layer")) || !keep.count(tag_attr(edge.tag, "to-layer"))) {
+            removed.emplace_back(edge.begin, edge.end);
+        }
+    }
+    size_t statsBegin, statsEnd;
+    if (find_section(xml, "statistics", statsBegin, statsEnd)) {
+        for (const auto &layer : find_elements(xml, "layer", statsBegin + 1, statsEnd)) {
+            size_t nameBegin = xml.find("<name>", layer.begin);
+            size_t nameEnd = xml.find("</name>", layer.begin);
+            if (nameBegin == std::string::npos || nameEnd == std::string::npos || nameEnd > layer.end) {
+                continue;
+            }
+            nameBegin += 6;
+            if (!keepNames.count(xml.substr(nameBegin, nameEnd - nameBegin))) {
+                removed.emplace_back(layer.begin, layer.end);
+            }
+        }
+    }
+    std::sort(removed.begin(), removed.end());
+
+    pruned.clear();
+    pruned.reserve(xml.size());
+    size_t pos = 0;
+    for (const auto &range : removed) {
+        pruned.append(xml, pos, range.first - pos);
+        pos = range.second;
+    }
+    pruned.append(xml, pos, std::string::npos);
+    slog::info << "pruned model to " << keep.size() << " of " << layers.size() << " layers" << slog::endl;
+    return 1;
+}
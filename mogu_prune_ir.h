@@ -0,0 +1,21 @@
+//
+// Created by adai on 2019/01/25.
+//
+
+#ifndef DDUP_MOGU_PRUNE_IR_H
+#define DDUP_MOGU_PRUNE_IR_H
+
+#include <string>
+#include <vector>
+
+/**
+ * 裁剪IR模型描述(.xml):只保留计算特征层所需的层(特征层及其全部上游层),
+ * 删除其余层,与之相连的边和统计信息;权重文件不变,被删除层的权重不再被访问
+ * 只处理IR的<layers>,<edges>和<statistics>结构,层名按xml中的原文匹配
+ * @param featureLayers 特征层名称
+ * @param pruned 输出裁剪后的xml
+ * @return 全部特征层都存在时返回1
+ */
+int prune_ir(const std::string &xml, const std::vector<std::string> &featureLayers, std::string &pruned);
+
+#endif //DDUP_MOGU_PRUNE_IR_H
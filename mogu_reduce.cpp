@@ -0,0 +1,96 @@
+//
+// Created by adai on 2019/01/22.
+//
+
+#include "mogu_reduce.h"
+
+#include <algorithm>
+#include <cmath>
+
+/**
+ * 向量的L2范数倒数,零向量返回0
+ */
+static inline float inv_l2_norm(const float *pRow, size_t rowDim) {
+    float sum = 0.0f;
+    for (size_t i = 0; i < rowDim; ++i) {
+        sum += pRow[i] * pRow[i];
+    }
+    return sum > 0.0f ? 1.0f / std::sqrt(sum) : 0.0f;
+}
+
+/**
+ * 视图归约
+ * 逐视图累加到输出行,内层循环连续访问便于编译器向量化;第一个视图在原地归约时已位于输出行
+ */
+void reduce_views(const float *pSrc, size_t views, size_t rowDim, ViewReduction reduction, float *pDst) {
+    if (views == 0 || reduction == ViewReduction::NONE) {
+        return;
+    }
+    switch (reduction) {
+        case ViewReduction::MEAN: {
+            if (pDst != pSrc) {
+                std::copy(pSrc, pSrc + rowDim, pDst);
+            }
+            for (size_t v = 1; v < views; ++v) {
+                const float *pRow = pSrc + v * rowDim;
+                for (size_t i = 0; i < rowDim; ++i) {
+                    pDst[i] += pRow[i];
+                }
+            }
+            float inv = 1.0f / views;
+            for (size_t i = 0; i < rowDim; ++i) {
+                pDst[i] *= inv;
+            }
+            break;
+        }
+        case ViewReduction::MAX: {
+            if (pDst != pSrc) {
+                std::copy(pSrc, pSrc + rowDim, pDst);
+            }
+            for (size_t v = 1; v < views; ++v) {
+                const float *pRow = pSrc + v * rowDim;
+                for (size_t i = 0; i < rowDim; ++i) {
+                    pDst[i] = std::max(pDst[i], pRow[i]);
+                }
+            }
+            break;
+        }
+        case ViewReduction::L2_MEAN: {
+            /** 原地归约时只有第一个视图会被覆盖,其范数在写入前算出,其余视图的范数在累加时现算,不分配缓冲区 **/
+            float inv0 = inv_l2_norm(pSrc, rowDim);
+            for (size_t i = 0; i < rowDim; ++i) {
+                pDst[i] = pSrc[i] * inv0;
+            }
+            for (size_t v = 1; v < views; ++v) {
+                const float *pRow = pSrc + v * rowDim;
+                float invNorm = inv_l2_norm(pRow, rowDim);
+                for (size_t i = 0; i < rowDim; ++i) {
+                    pDst[i] += pRow[i] * invNorm;
+                }
+            }
+            float inv = inv_l2_norm(pDst, rowDim);
+            for (size_t i = 0; i < rowDim; ++i) {
+                pDst[i] *= inv;
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+/**
+ * 余弦相似度
+ */
+float cosine_similarity(const float *pA, const float *pB, size_t dim) {
+    float dot = 0.0f, normA = 0.0f, normB = 0.0f;
+    for (size_t i = 0; i < dim; ++i) {
+        dot += pA[i] * pB[i];
+        normA += pA[i] * pA[i];
+        normB += pB[i] * pB[i];
+    }
+    if (normA <= 0.0f || normB <= 0.0f) {
+        return 0.0f;
+    }
+    return dot / std::sqrt(normA * normB);
+}
@@ -0,0 +1,38 @@
+//
+// Created by adai on 2019/01/22.
+//
+
+#ifndef DDUP_MOGU_REDUCE_H
+#define DDUP_MOGU_REDUCE_H
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * 多视图(裁剪 x 翻转)结果的归约方式
+ */
+enum class ViewReduction : uint8_t {
+    /**
+     * 不归约,返回每个视图的结果
+     */
+    NONE,
+    MEAN,
+    MAX,
+    /**
+     * 各视图先L2归一化再取平均,平均结果再次L2归一化
+     */
+    L2_MEAN,
+};
+
+/**
+ * 把views个连续的视图结果(每个rowDim个float)归约为一行
+ * @param pDst 输出rowDim个float,可以与pSrc相同(原地归约)
+ */
+void reduce_views(const float *pSrc, size_t views, size_t rowDim, ViewReduction reduction, float *pDst);
+
+/**
+ * 两个向量的余弦相似度,任一为零向量时返回0
+ */
+float cosine_similarity(const float *pA, const float *pB, size_t dim);
+
+#endif //DDUP_MOGU_REDUCE_H
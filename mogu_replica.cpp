@@ -0,0 +1,88 @@
+//
+// Created by adai on 2019/01/18.
+//
+
+#include "mogu_replica.h"
+#include "mogu_cpu_topology.h"
+
+#include <iostream>
+#include <samples/slog.hpp>
+
+/**
+ * 启动副本
+ */
+NetReplica::NetReplica(const NetworkLoader &loader, const std::vector<int> &cpus) : boundCpus(cpus) {
+    /** 加载结果由工作线程持有的promise通知,构造函数返回后工作线程不再访问本函数的局部变量 **/
+    auto ready = std::make_shared<std::promise<void>>();
+    std::future<void> loaded = ready->get_future();
+    worker = std::thread([this, loader, ready] { run(loader, *ready); });
+    try {
+        loaded.get();
+    } catch (...) {
+        worker.join();
+        throw;
+    }
+}
+
+/**
+ * 停止副本
+ */
+NetReplica::~NetReplica() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    cond.notify_all();
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+/**
+ * 提交推断任务
+ */
+std::future<void> NetReplica::submit(const Job &job) {
+    std::packaged_task<void(InferRequest &)> task(job);
+    std::future<void> done = task.get_future();
+    pending++;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(std::move(task));
+    }
+    cond.notify_one();
+    return done;
+}
+
+/**
+ * 工作线程:绑核,加载网络,依次执行任务
+ */
+void NetReplica::run(const NetworkLoader &loader, std::promise<void> &ready) {
+    if (!pin_current_thread(boundCpus)) {
+        slog::warn << "can not pin replica to its cores, running unpinned" << slog::endl;
+    }
+    try {
+        /** 在绑定的核上加载网络并创建请求,内存首次访问发生在本线程 **/
+        network = loader();
+        request = network.CreateInferRequestPtr();
+    } catch (...) {
+        ready.set_exception(std::current_exception());
+        return;
+    }
+    ready.set_value();
+
+    while (true) {
+        std::packaged_task<void(InferRequest &)> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cond.wait(lock, [this] { return stopping || !jobs.empty(); });
+            if (jobs.empty()) {
+                return;
+            }
+            task = std::move(jobs.front());
+            jobs.pop_front();
+        }
+        /** 任务异常由packaged_task转交给提交者 **/
+        task(*request);
+        pending--;
+    }
+}
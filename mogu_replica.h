@@ -0,0 +1,82 @@
+//
+// Created by adai on 2019/01/18.
+//
+
+#ifndef DDUP_MOGU_REPLICA_H
+#define DDUP_MOGU_REPLICA_H
+
+#include <atomic>
+#include <deque>
+#include <future>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <condition_variable>
+
+#include <inference_engine.hpp>
+
+using namespace InferenceEngine;
+
+/**
+ * 可执行网络副本
+ * 每个副本有一个绑定到固定物理核的工作线程,网络在该线程中加载(单线程推断),
+ * 推断任务在该线程中依次执行,副本之间互不争抢核
+ */
+class NetReplica {
+public:
+    typedef std::function<ExecutableNetwork()> NetworkLoader;
+    typedef std::function<void(InferRequest &)> Job;
+
+    /**
+     * 启动工作线程,绑定到cpus后加载网络并创建请求;加载完成后返回,加载失败时抛出异常
+     */
+    NetReplica(const NetworkLoader &loader, const std::vector<int> &cpus);
+
+    /**
+     * 执行完已提交的任务后停止工作线程
+     */
+    ~NetReplica();
+
+    NetReplica(const NetReplica &) = delete;
+    NetReplica &operator=(const NetReplica &) = delete;
+
+    /**
+     * 提交推断任务,任务在工作线程中以副本的请求执行
+     * @return 任务完成(或抛出异常)时就绪
+     */
+    std::future<void> submit(const Job &job);
+
+    /**
+     * 未完成的任务数
+     */
+    int load() const {
+        return pending.load();
+    }
+
+    /**
+     * 绑定的逻辑CPU
+     */
+    const std::vector<int> &cpus() const {
+        return boundCpus;
+    }
+
+private:
+    /**
+     * 工作线程
+     */
+    void run(const NetworkLoader &loader, std::promise<void> &ready);
+
+    std::vector<int> boundCpus;
+    ExecutableNetwork network;
+    InferRequest::Ptr request;
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::deque<std::packaged_task<void(InferRequest &)>> jobs;
+    std::atomic<int> pending{0};
+    bool stopping = false;
+    std::thread worker;
+};
+
+#endif //DDUP_MOGU_REPLICA_H
@@ -0,0 +1,86 @@
+//
+// Created by adai on 2019/01/21.
+//
+
+#include "mogu_weights_cache.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <iostream>
+
+#include <samples/slog.hpp>
+
+MappedWeights::~MappedWeights() {
+    if (data) {
+        munmap(data, size);
+    }
+}
+
+/**
+ * 包装为权重blob
+ */
+TBlob<uint8_t>::Ptr MappedWeights::blob() const {
+    TensorDesc tensorDesc(Precision::U8, {size}, Layout::C);
+    return std::make_shared<TBlob<uint8_t>>(tensorDesc, data, size);
+}
+
+WeightsCache &WeightsCache::instance() {
+    static WeightsCache cache;
+    return cache;
+}
+
+/**
+ * 获取权重映射
+ */
+std::shared_ptr<const MappedWeights> WeightsCache::get(const std::string &binFile) {
+    int fd = open(binFile.c_str(), O_RDONLY);
+    if (fd < 0) {
+        slog::err << "can not open weights file: " << binFile << slog::endl;
+        return nullptr;
+    }
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0 || fileStat.st_size <= 0) {
+        close(fd);
+        return nullptr;
+    }
+    char version[96];
+    snprintf(version, sizeof(version), "|%lu|%lld|%lld", (unsigned long) fileStat.st_ino,
+             (long long) fileStat.st_size, (long long) fileStat.st_mtime);
+    std::string key = binFile + version;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    std::shared_ptr<const MappedWeights> mapped = mappings[key].lock();
+    if (mapped) {
+        close(fd);
+        return mapped;
+    }
+
+    /** 只读映射,与page cache共享;意外写入直接触发段错误,而不是悄悄产生私有副本 **/
+    size_t size = static_cast<size_t>(fileStat.st_size);
+    void *addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        slog::err << "can not mmap weights file: " << binFile << slog::endl;
+        mappings.erase(key);
+        return nullptr;
+    }
+    /** 加载网络时会顺序读完全部权重 **/
+    madvise(addr, size, MADV_WILLNEED);
+
+    std::shared_ptr<MappedWeights> created = std::make_shared<MappedWeights>();
+    created->data = static_cast<uint8_t *>(addr);
+    created->size = size;
+    mappings[key] = created;
+
+    /** 顺带清理已失效的条目 **/
+    for (auto item = mappings.begin(); item != mappings.end();) {
+        if (item->second.expired()) {
+            item = mappings.erase(item);
+        } else {
+            ++item;
+        }
+    }
+    return created;
+}
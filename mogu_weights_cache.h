@@ -0,0 +1,59 @@
+//
+// Created by adai on 2019/01/21.
+//
+
+#ifndef DDUP_MOGU_WEIGHTS_CACHE_H
+#define DDUP_MOGU_WEIGHTS_CACHE_H
+
+#include <map>
+#include <mutex>
+#include <memory>
+#include <string>
+
+#include <inference_engine.hpp>
+
+using namespace InferenceEngine;
+
+/**
+ * 内存映射的权重文件,映射期间权重页直接来自page cache,多个网络和进程共享
+ */
+struct MappedWeights {
+    MappedWeights() = default;
+    ~MappedWeights();
+    MappedWeights(const MappedWeights &) = delete;
+    MappedWeights &operator=(const MappedWeights &) = delete;
+
+    /**
+     * 映射地址和文件大小,映射只读
+     */
+    uint8_t *data = nullptr;
+    size_t size = 0;
+
+    /**
+     * 包装为权重blob(不拷贝),blob使用期间须持有本映射
+     */
+    TBlob<uint8_t>::Ptr blob() const;
+};
+
+/**
+ * 进程级权重缓存
+ * 按(文件路径,inode,大小,修改时间)缓存映射,文件被替换(如热更新)后重新映射;
+ * 所有使用者释放后解除映射
+ */
+class WeightsCache {
+public:
+    static WeightsCache &instance();
+
+    /**
+     * 获取权重映射,失败时返回nullptr
+     */
+    std::shared_ptr<const MappedWeights> get(const std::string &binFile);
+
+private:
+    WeightsCache() = default;
+
+    std::mutex mutex;
+    std::map<std::string, std::weak_ptr<const MappedWeights>> mappings;
+};
+
+#endif //DDUP_MOGU_WEIGHTS_CACHE_H